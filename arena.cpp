@@ -0,0 +1,91 @@
+#include "arena.h"
+#include <cstdlib>
+#include <stdint.h>
+
+Arena::Arena(size_t slabSize) :
+			_slabs        (NULL),
+			_cursor       (NULL),
+			_end          (NULL),
+			_slabSize     (slabSize),
+			_bytesReserved(0),
+			_bytesUsed    (0),
+			_numSlabs     (0)
+			{}
+
+Arena::~Arena()
+{
+	release();
+}
+
+Arena::Slab* Arena::newSlab(size_t size)
+{
+	Slab* slab = static_cast<Slab*>(malloc(sizeof(Slab) + size));
+	if (!slab) {
+		throw std::bad_alloc();
+	}
+	slab->size      = size;
+	_bytesReserved += sizeof(Slab) + size;
+	_numSlabs++;
+	return slab;
+}
+
+void* Arena::allocate(size_t size, size_t alignment)
+{
+	uintptr_t cursor  = reinterpret_cast<uintptr_t>(_cursor);
+	uintptr_t aligned = (cursor + alignment - 1) & ~(uintptr_t) (alignment - 1);
+	if (_cursor && aligned + size <= reinterpret_cast<uintptr_t>(_end)) {
+		// Fast path: bump the pointer in the current slab
+		_bytesUsed += aligned + size - cursor;
+		_cursor     = reinterpret_cast<char*>(aligned + size);
+		return reinterpret_cast<void*>(aligned);
+	}
+	
+	size_t needed = size + alignment;
+	if (needed > _slabSize / 4) {
+		// Big request: dedicated slab, linked after the current one
+		// so the free space of the current slab is still used
+		Slab* slab = newSlab(needed);
+		if (_slabs) {
+			slab->next   = _slabs->next;
+			_slabs->next = slab;
+		} else {
+			slab->next = NULL;
+			_slabs     = slab;
+		}
+		uintptr_t begin = reinterpret_cast<uintptr_t>(slab + 1);
+		aligned     = (begin + alignment - 1) & ~(uintptr_t) (alignment - 1);
+		_bytesUsed += aligned + size - begin;
+		return reinterpret_cast<void*>(aligned);
+	}
+	
+	// Current slab exhausted: start a new one
+	Slab* slab = newSlab(_slabSize);
+	slab->next = _slabs;
+	_slabs     = slab;
+	_cursor    = reinterpret_cast<char*>(slab + 1);
+	_end       = _cursor + _slabSize;
+	return allocate(size, alignment);
+}
+
+void Arena::release()
+{
+	while (_slabs) {
+		Slab* next = _slabs->next;
+		free(_slabs);
+		_slabs = next;
+	}
+	_cursor        = NULL;
+	_end           = NULL;
+	_bytesReserved = 0;
+	_bytesUsed     = 0;
+	_numSlabs      = 0;
+}
+
+ArenaStats Arena::stats() const
+{
+	ArenaStats result;
+	result.bytesReserved = _bytesReserved;
+	result.bytesUsed     = _bytesUsed;
+	result.numSlabs      = _numSlabs;
+	return result;
+}
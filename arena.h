@@ -0,0 +1,78 @@
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+// File declares the arena allocator used by the stock market for
+// everything it owns (stocks and trade columns).
+// Memory is allocated by bumping a pointer inside large slabs and it is
+// only given back when the whole arena is released: the teardown of a
+// market is a handful of slab frees instead of one 'delete' per object.
+
+//! Statistics of an arena
+struct ArenaStats
+{
+	size_t bytesReserved; // bytes allocated from the system for all slabs
+	size_t bytesUsed;     // bytes handed out by 'allocate', including alignment padding
+	size_t numSlabs;
+};
+
+//! Bump pointer allocator over a list of slabs
+class Arena
+{
+	public:
+		static const size_t DEFAULT_SLAB_SIZE = 1 << 20;
+		
+		Arena(size_t slabSize = DEFAULT_SLAB_SIZE);
+		~Arena();
+		
+		//! Allocate 'size' bytes aligned on 'alignment' (power of 2)
+		//! Requests bigger than a quarter of the slab size get their own slab
+		void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+		
+		//! Allocate an uninitialized array of 'count' objects of type T
+		template<typename T>
+		T* allocateArray(size_t count) {
+			return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+		}
+		
+		//! Construct an object of type T in the arena
+		//! NOTE: the arena never calls destructors, objects owning
+		//! other resources must be destroyed explicitly by the caller
+		template<typename T, typename... Args>
+		T* create(Args&&... args) {
+			return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+		}
+		
+		//! Give all slabs back to the system. Previously allocated memory
+		//! must not be used anymore
+		void release();
+		
+		//! Accessing
+		ArenaStats stats() const;
+		
+	private:
+		struct Slab {
+			Slab*  next;
+			size_t size;  // usable bytes following this header
+		};
+		
+		Slab* newSlab(size_t size);
+		
+		Slab*  _slabs;     // list of all slabs, the current one first
+		char*  _cursor;    // next free byte in the current slab
+		char*  _end;       // end of the current slab
+		size_t _slabSize;
+		size_t _bytesReserved;
+		size_t _bytesUsed;
+		size_t _numSlabs;
+		
+	//! Disable copy constructor and 
+	//! copy assignment operator
+	Arena(const Arena&);
+	Arena& operator=(const Arena&);
+};
+
+#endif
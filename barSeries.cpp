@@ -0,0 +1,101 @@
+#include "barSeries.h"
+#include <algorithm>
+
+using namespace std;
+
+//! Order of the bars by start time
+static bool startsBefore(Bar const& bar, time_t start)
+{
+	return bar.start < start;
+}
+
+static bool startsAfter(time_t start, Bar const& bar)
+{
+	return start < bar.start;
+}
+
+BarSeries::BarSeries(time_t resolution) :
+			_resolution(resolution > 0 ? resolution : 1),
+			_bars      (),
+			_first     (0)
+			{}
+
+time_t BarSeries::barStart(time_t timestamp) const
+{
+	// Round toward minus infinity, also for timestamps before the epoch
+	time_t remainder = timestamp % _resolution;
+	return timestamp - (remainder < 0 ? remainder + _resolution : remainder);
+}
+
+void BarSeries::initBar(Bar& bar, time_t start, time_t timestamp, int price, int quantity)
+{
+	bar.start         = start;
+	bar.open          = price;
+	bar.high          = price;
+	bar.low           = price;
+	bar.close         = price;
+	bar.volume        = quantity;
+	bar.priceQuantity = (long long) price * quantity;
+	bar.numTrades     = 1;
+	bar.openTime      = timestamp;
+	bar.closeTime     = timestamp;
+}
+
+void BarSeries::mergeBar(Bar& bar, time_t timestamp, int price, int quantity)
+{
+	if (timestamp < bar.openTime) {
+		bar.open     = price;
+		bar.openTime = timestamp;
+	}
+	// Trades of the same time close the bar in arrival order
+	if (timestamp >= bar.closeTime) {
+		bar.close     = price;
+		bar.closeTime = timestamp;
+	}
+	bar.high           = std::max(bar.high, price);
+	bar.low            = std::min(bar.low,  price);
+	bar.volume        += quantity;
+	bar.priceQuantity += (long long) price * quantity;
+	bar.numTrades++;
+}
+
+void BarSeries::addTrade(time_t timestamp, int price, int quantity)
+{
+	time_t start = barStart(timestamp);
+	if (_bars.size() > _first && _bars.back().start == start) {
+		mergeBar(_bars.back(), timestamp, price, quantity);
+	} else if (_bars.size() == _first || _bars.back().start < start) {
+		_bars.push_back(Bar());
+		initBar(_bars.back(), start, timestamp, price, quantity);
+	} else {
+		// Late trade: find its bar among the older ones, a missing bar
+		// moves the newer ones
+		vector<Bar>::iterator it = lower_bound(_bars.begin() + _first, _bars.end(), start, startsBefore);
+		if (it->start == start) {
+			mergeBar(*it, timestamp, price, quantity);
+		} else {
+			initBar(*_bars.insert(it, Bar()), start, timestamp, price, quantity);
+		}
+	}
+}
+
+BarRange BarSeries::bars(time_t from, time_t to) const
+{
+	BarRange result;
+	if (from <= to && _bars.size() > _first) {
+		const Bar* begin = _bars.data() + _first;
+		const Bar* end   = _bars.data() + _bars.size();
+		result.first = lower_bound(begin, end, barStart(from), startsBefore);
+		result.last  = upper_bound(result.first, end, to, startsAfter);
+	}
+	return result;
+}
+
+void BarSeries::expire(time_t timestamp)
+{
+	_first = lower_bound(_bars.begin() + _first, _bars.end(), barStart(timestamp), startsBefore) - _bars.begin();
+	if (_first > 0 && _first * 2 >= _bars.size()) {
+		_bars.erase(_bars.begin(), _bars.begin() + _first);
+		_first = 0;
+	}
+}
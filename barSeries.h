@@ -0,0 +1,89 @@
+#ifndef _BAR_SERIES_H
+#define _BAR_SERIES_H
+
+#include <vector>
+#include <cstddef>
+#include "time.h"
+
+// File declares the open/high/low/close/volume bars of a stock, maintained
+// as trades arrive so chart queries cost O(bars) instead of O(trades).
+
+class BarSeries;
+
+typedef std::vector<BarSeries> BarSeriesVec; // bars of each stock indexed by symbol identifier
+
+//! Trades of a stock within [start, start + resolution)
+struct Bar
+{
+	time_t    start;
+	int       open;            // price of the earliest trade
+	int       high;
+	int       low;
+	int       close;           // price of the latest trade
+	long long volume;          // sum of the quantities
+	long long priceQuantity;   // sum of price x quantity
+	size_t    numTrades;
+	time_t    openTime;        // timestamp of the open trade
+	time_t    closeTime;       // timestamp of the close trade
+
+	//! Volume weighted price of the bar, 0 for a null volume
+	double vwap() const { return volume > 0 ? (double) priceQuantity / volume : 0.0; }
+};
+
+//! Consecutive bars of a series, ordered by start time.
+//! The range is invalidated by the next trade added to the series
+struct BarRange
+{
+	BarRange() : first(NULL), last(NULL) {}
+	BarRange(const Bar* begin, const Bar* end) : first(begin), last(end) {}
+
+	const Bar* begin() const { return first;        }
+	const Bar* end  () const { return last;         }
+	size_t     size () const { return last - first; }
+	bool       empty() const { return last == first; }
+	Bar const& operator[](size_t i) const { return first[i]; }
+
+	const Bar* first;
+	const Bar* last;
+};
+
+//! Bars of a given resolution of a stock.
+//! Bars without trades are not stored. A trade of the latest bar or of a
+//! new bar costs O(1), a late trade of an existing older bar O(log bars).
+//! A late trade opening an older bar inserts it in the middle of the bars
+//! and costs O(bars): trades are late by far less than a bar, so such a
+//! bar is rare, and the bars stay contiguous for the range queries.
+//! Bars holding expired trades only are skipped, then erased at once
+//! when they are the larger part of the series
+class BarSeries
+{
+	public:
+		BarSeries(time_t resolution = 60);
+
+		//! Accessing
+		time_t     resolution() const { return _resolution;  }
+		size_t     size      () const { return _bars.size() - _first; }
+		Bar const& bar(size_t i) const { return _bars[_first + i];    }
+
+		//! Start of the bar holding a given time
+		time_t barStart(time_t timestamp) const;
+
+		//! Add a trade to the bar of its timestamp
+		void addTrade(time_t timestamp, int price, int quantity);
+
+		//! Bars holding the trades timestamped in [from, to], O(log bars)
+		BarRange bars(time_t from, time_t to) const;
+		
+		//! Drop the bars ending before 'timestamp', the oldest trade kept
+		void expire(time_t timestamp);
+
+	private:
+		static void initBar (Bar& bar, time_t start, time_t timestamp, int price, int quantity);
+		static void mergeBar(Bar& bar, time_t timestamp, int price, int quantity);
+
+		time_t           _resolution;
+		std::vector<Bar> _bars;   // ordered by start time, expired ones first
+		size_t           _first;  // first bar not expired
+};
+
+#endif
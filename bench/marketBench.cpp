@@ -0,0 +1,245 @@
+// Benchmark of the stock market hot paths on a synthetic workload.
+// Reports ns/op and latency percentiles of addTrade, findStock, getTrades
+// and computeStockValues, of the limit orders and cancels of an order book,
+// and the peak resident memory, as text and JSON.
+//
+// Usage: marketBench [--symbols=N] [--trades=N] [--rate=TRADES_PER_SEC]
+//                    [--zipf=SKEW] [--window=SECONDS] [--out-of-window=RATIO]
+//                    [--queries=N] [--computes=N] [--orders=N] [--seed=N] [--json=PATH]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include "../stockMarket.h"
+#include "../orderBook.h"
+#include "../diagnostics.h"
+#include "workload.h"
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+//! Latencies of one operation
+class OperationStats
+{
+	public:
+		OperationStats(const char* name) : _name(name), _samples(), _totalNs(0) {}
+		
+		void add(uint64_t ns) {
+			_samples.push_back(ns);
+			_totalNs += ns;
+		}
+		
+		const char* name() const { return _name; }
+		size_t      count() const { return _samples.size(); }
+		double      nsPerOp() const { return _samples.empty() ? 0.0 : (double) _totalNs / _samples.size(); }
+		
+		//! Percentile in [0, 100], the samples must be sorted
+		uint64_t percentile(double p) const {
+			if (_samples.empty()) {
+				return 0;
+			}
+			size_t i = (size_t) (p / 100.0 * (_samples.size() - 1) + 0.5);
+			return _samples[min(i, _samples.size() - 1)];
+		}
+		
+		void sort() { std::sort(_samples.begin(), _samples.end()); }
+		
+	private:
+		const char*      _name;
+		vector<uint64_t> _samples;
+		uint64_t         _totalNs;
+};
+
+static uint64_t elapsedNs(Clock::time_point start)
+{
+	return (uint64_t) chrono::duration_cast<chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+static long peakRssKb()
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+//! Parse '--name=value' arguments, returns false on unknown arguments
+//! or without any symbol
+static bool parseArguments(int argc, char** argv, WorkloadConfig& config, string& jsonPath)
+{
+	for (int i = 1; i < argc; ++i) {
+		const char* arg   = argv[i];
+		const char* equal = strchr(arg, '=');
+		if (strncmp(arg, "--", 2) != 0 || !equal) {
+			return false;
+		}
+		string      name (arg + 2, equal);
+		const char* value = equal + 1;
+		if      (name == "symbols")       config.numSymbols       = strtoull(value, NULL, 10);
+		else if (name == "trades")        config.numTrades        = strtoull(value, NULL, 10);
+		else if (name == "rate")          config.tradeRate        = strtod  (value, NULL);
+		else if (name == "zipf")          config.zipfSkew         = strtod  (value, NULL);
+		else if (name == "window")        config.windowSeconds    = (time_t) strtoll(value, NULL, 10);
+		else if (name == "out-of-window") config.outOfWindowRatio = strtod  (value, NULL);
+		else if (name == "queries")       config.numQueries       = strtoull(value, NULL, 10);
+		else if (name == "computes")      config.numComputes      = strtoull(value, NULL, 10);
+		else if (name == "orders")        config.numOrders        = strtoull(value, NULL, 10);
+		else if (name == "seed")          config.seed             = strtoull(value, NULL, 10);
+		else if (name == "json")          jsonPath                = value;
+		else return false;
+	}
+	// Trades and orders are drawn among the symbols
+	return config.numSymbols > 0;
+}
+
+static void writeJson(FILE* out, WorkloadConfig const& config,
+					  vector<OperationStats*> const& operations, long rssKb)
+{
+	fprintf(out, "{\n  \"config\": {\"seed\": %llu, \"symbols\": %zu, \"trades\": %zu, "
+				 "\"rate\": %g, \"zipf\": %g, \"window\": %lld, \"out_of_window\": %g, "
+				 "\"queries\": %zu, \"computes\": %zu, \"orders\": %zu},\n",
+			(unsigned long long) config.seed, config.numSymbols, config.numTrades,
+			config.tradeRate, config.zipfSkew, (long long) config.windowSeconds,
+			config.outOfWindowRatio, config.numQueries, config.numComputes, config.numOrders);
+	fprintf(out, "  \"operations\": {\n");
+	for (size_t i = 0; i < operations.size(); ++i) {
+		OperationStats const& op = *operations[i];
+		fprintf(out, "    \"%s\": {\"count\": %zu, \"ns_per_op\": %.1f, \"p50\": %llu, "
+					 "\"p90\": %llu, \"p99\": %llu, \"p999\": %llu, \"max\": %llu}%s\n",
+				op.name(), op.count(), op.nsPerOp(),
+				(unsigned long long) op.percentile(50),
+				(unsigned long long) op.percentile(90),
+				(unsigned long long) op.percentile(99),
+				(unsigned long long) op.percentile(99.9),
+				(unsigned long long) op.percentile(100),
+				i + 1 < operations.size() ? "," : "");
+	}
+	fprintf(out, "  },\n  \"peak_rss_kb\": %ld\n}\n", rssKb);
+}
+
+int main(int argc, char** argv)
+{
+	WorkloadConfig config;
+	string         jsonPath;
+	if (!parseArguments(argc, argv, config, jsonPath)) {
+		fprintf(stderr, "usage: %s [--symbols=N] [--trades=N] [--rate=R] [--zipf=S] [--window=SECONDS]\n"
+						"          [--out-of-window=RATIO] [--queries=N] [--computes=N] [--orders=N] [--seed=N]\n"
+						"          [--json=PATH]\n",
+				argv[0]);
+		return 1;
+	}
+	
+	time_t now;
+	time(&now);
+	Workload workload(config, now);
+	
+	OperationStats addTrade  ("addTrade");
+	OperationStats findStock ("findStock");
+	OperationStats getTrades ("getTrades");
+	OperationStats compute   ("computeStockValues");
+	OperationStats addOrder  ("addOrder");
+	OperationStats cancel    ("cancelOrder");
+	
+	// Market diagnostics are not part of the measure
+	diagnostics().setEnabled(false);
+	
+	StockMarket market("BENCH", "", "");
+	for (auto const& stock : workload.stocks()) {
+		if (stock.preferred) {
+			PreferredStock preferred(stock.symbol.c_str(), stock.lastDividend, stock.parValue, stock.fixedDividend);
+			market.addStock(&preferred);
+		} else {
+			Stock common(stock.symbol.c_str(), stock.lastDividend, stock.parValue);
+			market.addStock(&common);
+		}
+	}
+	
+	// Ingestion, with computations spread over it
+	vector<TradeRecord> const& trades = workload.trades();
+	size_t computeEvery = config.numComputes ? max<size_t>(trades.size() / config.numComputes, 1) : 0;
+	for (size_t i = 0; i < trades.size(); ++i) {
+		TradeRecord const& trade = trades[i];
+		Clock::time_point  start = Clock::now();
+		market.addTrade(trade.id, trade.price, trade.quantity, trade.buy, trade.timestamp);
+		addTrade.add(elapsedNs(start));
+		
+		if (computeEvery && (i + 1) % computeEvery == 0 && compute.count() < config.numComputes) {
+			start = Clock::now();
+			market.computeStockValues();
+			compute.add(elapsedNs(start));
+		}
+	}
+	
+	// Queries by symbol
+	size_t checksum = 0;
+	for (auto query : workload.queries()) {
+		const char*       symbol = workload.stocks()[query].symbol.c_str();
+		Clock::time_point start  = Clock::now();
+		const Stock*      stock  = market.findStock(symbol);
+		findStock.add(elapsedNs(start));
+		checksum += stock ? (size_t) stock->lastPrice() : 0;
+		
+		start = Clock::now();
+		TradesView view = market.getTrades(symbol);
+		getTrades.add(elapsedNs(start));
+		checksum += view.size();
+	}
+	
+	// Order flow matched by the book of the first stock, its executions
+	// are added to the market
+	OrderBook       book(market, workload.stocks().front().symbol.c_str());
+	vector<OrderId> orderIds(workload.orders().size(), INVALID_ORDER);
+	for (size_t i = 0; i < workload.orders().size(); ++i) {
+		WorkloadOrder const& order = workload.orders()[i];
+		Clock::time_point    start = Clock::now();
+		if (order.cancel) {
+			checksum += book.cancel(orderIds[order.target]) ? 1 : 0;
+			cancel.add(elapsedNs(start));
+		} else {
+			orderIds[i] = book.addOrder(order.buy, order.price, order.quantity, now).id;
+			addOrder.add(elapsedNs(start));
+		}
+	}
+	checksum += book.numOrders();
+	
+	vector<OperationStats*> operations;
+	operations.push_back(&addTrade);
+	operations.push_back(&findStock);
+	operations.push_back(&getTrades);
+	operations.push_back(&compute);
+	operations.push_back(&addOrder);
+	operations.push_back(&cancel);
+	
+	long rssKb = peakRssKb();
+	printf("%-20s %10s %10s %8s %8s %8s %8s %10s\n",
+		   "operation", "count", "ns/op", "p50", "p90", "p99", "p99.9", "max");
+	for (auto op : operations) {
+		op->sort();
+		printf("%-20s %10zu %10.1f %8llu %8llu %8llu %8llu %10llu\n",
+			   op->name(), op->count(), op->nsPerOp(),
+			   (unsigned long long) op->percentile(50),
+			   (unsigned long long) op->percentile(90),
+			   (unsigned long long) op->percentile(99),
+			   (unsigned long long) op->percentile(99.9),
+			   (unsigned long long) op->percentile(100));
+	}
+	printf("peak RSS %ld KB (checksum %zu)\n", rssKb, checksum);
+	
+	if (!jsonPath.empty()) {
+		FILE* out = jsonPath == "-" ? stdout : fopen(jsonPath.c_str(), "w");
+		if (!out) {
+			fprintf(stderr, "Cannot write '%s'\n", jsonPath.c_str());
+			return 1;
+		}
+		writeJson(out, config, operations, rssKb);
+		if (out != stdout) {
+			fclose(out);
+		}
+	}
+	return 0;
+}
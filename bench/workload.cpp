@@ -0,0 +1,102 @@
+#include "workload.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+using namespace std;
+
+WorkloadConfig::WorkloadConfig() :
+			seed            (42),
+			numSymbols      (1000),
+			numTrades       (1000000),
+			tradeRate       (10000.0),
+			zipfSkew        (1.0),
+			windowSeconds   (300),
+			outOfWindowRatio(0.05),
+			numQueries      (100000),
+			numComputes     (100),
+			numOrders       (1000000)
+			{}
+
+Workload::Workload(WorkloadConfig const& config, time_t now) :
+			_config (config),
+			_random (config.seed),
+			_cdf    (),
+			_stocks (),
+			_trades (),
+			_queries(),
+			_orders ()
+{
+	size_t numSymbols = max<size_t>(_config.numSymbols, 1);
+	
+	// Zipf cumulative distribution over the symbols
+	_cdf.resize(numSymbols);
+	double total = 0.0;
+	for (size_t i = 0; i < numSymbols; ++i) {
+		total  += 1.0 / pow((double) (i + 1), _config.zipfSkew);
+		_cdf[i] = total;
+	}
+	for (auto& value : _cdf) {
+		value /= total;
+	}
+	
+	uniform_int_distribution<int> dividend(0, 30);
+	uniform_int_distribution<int> parValue(1, 500);
+	uniform_int_distribution<int> percent (0, 100);
+	_stocks.resize(numSymbols);
+	for (size_t i = 0; i < numSymbols; ++i) {
+		char symbol[MAX_SYMBOL_LENGTH + 1];
+		snprintf(symbol, sizeof(symbol), "S%u", (unsigned int) i);
+		WorkloadStock& stock = _stocks[i];
+		stock.symbol        = symbol;
+		stock.preferred     = percent(_random) < 10;
+		stock.lastDividend  = dividend(_random);
+		stock.parValue      = parValue(_random);
+		stock.fixedDividend = stock.preferred ? dividend(_random) : 0;
+	}
+	
+	// Trades are timestamped at the trade rate, the last one at 'now'.
+	// Out of window trades are back-dated before 'now - windowSeconds'
+	uniform_real_distribution<double> unit     (0.0, 1.0);
+	uniform_int_distribution<int>     price    (1, 1000);
+	uniform_int_distribution<int>     quantity (1, 1000);
+	uniform_int_distribution<time_t>  lateness (1, 10 * _config.windowSeconds);
+	double rate = _config.tradeRate > 0.0 ? _config.tradeRate : 1.0;
+	_trades.resize(_config.numTrades);
+	for (size_t i = 0; i < _config.numTrades; ++i) {
+		size_t stock     = drawSymbol();
+		time_t timestamp = now - (time_t) ((_config.numTrades - 1 - i) / rate);
+		if (unit(_random) < _config.outOfWindowRatio) {
+			timestamp = now - _config.windowSeconds - lateness(_random);
+		}
+		setTradeRecord(_trades[i], _stocks[stock].symbol.c_str(),
+					   price(_random), quantity(_random), unit(_random) < 0.5,
+					   timestamp, (SymbolId) stock);
+	}
+	
+	_queries.resize(_config.numQueries);
+	for (auto& query : _queries) {
+		query = drawSymbol();
+	}
+	
+	// Order flow around a mid price, a third of the messages cancel
+	// an order sent before, which may have been executed since
+	uniform_int_distribution<int> offset(-10, 10);
+	uniform_int_distribution<int> size  (1, 100);
+	_orders.resize(_config.numOrders);
+	for (size_t i = 0; i < _config.numOrders; ++i) {
+		WorkloadOrder& order = _orders[i];
+		order.cancel   = i > 0 && percent(_random) < 33;
+		order.target   = order.cancel ? uniform_int_distribution<size_t>(0, i - 1)(_random) : 0;
+		order.buy      = unit(_random) < 0.5;
+		order.price    = 500 + offset(_random);
+		order.quantity = size(_random);
+	}
+}
+
+size_t Workload::drawSymbol()
+{
+	uniform_real_distribution<double> unit(0.0, 1.0);
+	size_t result = lower_bound(_cdf.begin(), _cdf.end(), unit(_random)) - _cdf.begin();
+	return min(result, _cdf.size() - 1);
+}
@@ -0,0 +1,77 @@
+#ifndef _WORKLOAD_H
+#define _WORKLOAD_H
+
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include <random>
+#include "../tradeRecord.h"
+
+// File declares the seeded generator of synthetic market workloads
+// used by the benchmark: the same configuration and seed always give
+// the same stocks, trades and queries.
+
+//! Workload parameters
+struct WorkloadConfig
+{
+	WorkloadConfig();
+	
+	uint64_t seed;
+	size_t   numSymbols;
+	size_t   numTrades;
+	double   tradeRate;         // trades per second of trading time
+	double   zipfSkew;          // 0 for uniform symbol popularity
+	time_t   windowSeconds;     // VWAP window the in-window trades are spread over
+	double   outOfWindowRatio;  // fraction of trades back-dated out of the window
+	size_t   numQueries;        // findStock and getTrades calls
+	size_t   numComputes;       // computeStockValues calls spread over the ingestion
+	size_t   numOrders;         // limit orders and cancels sent to the book of the first stock
+};
+
+//! Stock of a workload
+struct WorkloadStock
+{
+	std::string symbol;
+	bool        preferred;
+	int         lastDividend;
+	int         parValue;
+	int         fixedDividend;
+};
+
+//! Order of a workload: a limit order, or the cancel of a previous one
+struct WorkloadOrder
+{
+	bool   cancel;
+	size_t target;    // index of the cancelled order in the order flow
+	bool   buy;
+	int    price;
+	int    quantity;
+};
+
+//! Synthetic workload
+class Workload
+{
+	public:
+		Workload(WorkloadConfig const& config, time_t now);
+		
+		//! Accessing
+		WorkloadConfig const&             config () const { return _config;  }
+		std::vector<WorkloadStock> const& stocks () const { return _stocks;  }
+		std::vector<TradeRecord>   const& trades () const { return _trades;  }
+		std::vector<size_t>        const& queries() const { return _queries; } // stock indexes
+		std::vector<WorkloadOrder> const& orders () const { return _orders;  }
+		
+	private:
+		//! Draw a stock index following the Zipf distribution
+		size_t drawSymbol();
+		
+		WorkloadConfig             _config;
+		std::mt19937_64            _random;
+		std::vector<double>        _cdf;  // cumulative Zipf probabilities
+		std::vector<WorkloadStock> _stocks;
+		std::vector<TradeRecord>   _trades;
+		std::vector<size_t>        _queries;
+		std::vector<WorkloadOrder> _orders;
+};
+
+#endif
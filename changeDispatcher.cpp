@@ -0,0 +1,265 @@
+#include "changeDispatcher.h"
+#include "stockTable.h"
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+const size_t ChangeDispatcher::NO_CHANGE;
+
+ChangeFilter priceMoveAbove(double percent)
+{
+	double threshold = percent / 100.0;
+	return [threshold](StockChange const& change) {
+		return fabs(change.priceMove()) > threshold;
+	};
+}
+
+ChangeFilter vwapMoveAbove(double percent)
+{
+	double threshold = percent / 100.0;
+	return [threshold](StockChange const& change) {
+		return fabs(change.vwapMove()) > threshold;
+	};
+}
+
+ChangeDispatcher::ChangeDispatcher() :
+					_mutex             (),
+					_posted            (),
+					_idle              (),
+					_waiting           (),
+					_waitingIndex      (),
+					_latest            (),
+					_delivering        (false),
+					_stopping          (false),
+					_cycle             (0),
+					_stats             (),
+					_subscriptionsMutex(),
+					_subscriptions     (),
+					_nextId            (INVALID_SUBSCRIPTION + 1),
+					_thread            ()
+{
+	_thread = thread(&ChangeDispatcher::run, this);
+}
+
+ChangeDispatcher::~ChangeDispatcher()
+{
+	{
+		lock_guard<mutex> guard(_mutex);
+		_stopping = true;
+	}
+	_posted.notify_one();
+	_thread.join();
+	for (auto subscription : _subscriptions) {
+		delete subscription;
+	}
+}
+
+SubscriptionId ChangeDispatcher::add(Subscription* subscription)
+{
+	lock_guard<mutex> guard(_subscriptionsMutex);
+	subscription->id      = _nextId++;
+	subscription->removed = false;
+	_subscriptions.push_back(subscription);
+	return subscription->id;
+}
+
+SubscriptionId ChangeDispatcher::subscribe(vector<SymbolId> const& ids, ChangeCallback const& callback)
+{
+	Subscription* subscription = new Subscription();
+	subscription->callback = callback;
+	for (auto id : ids) {
+		if (id != INVALID_SYMBOL) {
+			if (id >= subscription->symbols.size()) {
+				subscription->symbols.resize(id + 1, false);
+			}
+			subscription->symbols[id] = true;
+		}
+	}
+	return add(subscription);
+}
+
+SubscriptionId ChangeDispatcher::subscribe(ChangeFilter const& filter, ChangeCallback const& callback)
+{
+	Subscription* subscription = new Subscription();
+	subscription->filter   = filter;
+	subscription->callback = callback;
+	return add(subscription);
+}
+
+bool ChangeDispatcher::unsubscribe(SubscriptionId id)
+{
+	if (onDispatcherThread()) {
+		// From a callback: the delivery holds the subscriptions lock and
+		// goes on with the next subscriptions, only mark this one
+		for (auto subscription : _subscriptions) {
+			if (subscription->id == id && !subscription->removed) {
+				subscription->removed = true;
+				return true;
+			}
+		}
+		return false;
+	}
+	// Waits for the delivery in progress, if any
+	lock_guard<mutex> guard(_subscriptionsMutex);
+	for (size_t i = 0; i < _subscriptions.size(); ++i) {
+		if (_subscriptions[i]->id == id) {
+			delete _subscriptions[i];
+			_subscriptions.erase(_subscriptions.begin() + i);
+			return true;
+		}
+	}
+	return false;
+}
+
+size_t ChangeDispatcher::numSubscriptions() const
+{
+	lock_guard<mutex> guard(_subscriptionsMutex);
+	return _subscriptions.size();
+}
+
+void ChangeDispatcher::post(vector<SymbolId> const& ids,
+							StockTable       const& table,
+							SymbolTable      const& symbols)
+{
+	bool wake = false;
+	{
+		lock_guard<mutex> guard(_mutex);
+		_cycle++;
+		_stats.cycles++;
+		if (_latest.size() < table.size()) {
+			Values unknown = { 0, 0.0, false };
+			_latest      .resize(table.size(), unknown);
+			_waitingIndex.resize(table.size(), NO_CHANGE);
+		}
+		for (auto id : ids) {
+			Values& latest = _latest[id];
+			int     price  = table.lastPrice(id);
+			double  vwap   = table.weightedStockPrice(id);
+			if (latest.known && latest.price == price && latest.vwap == vwap) {
+				continue;
+			}
+			// One waiting change per stock: from the values before the
+			// first change to the current ones
+			if (_waitingIndex[id] == NO_CHANGE) {
+				StockChange change;
+				change.id = id;
+				strncpy(change.symbol, symbols.name(id).c_str(), MAX_SYMBOL_LENGTH);
+				change.symbol[MAX_SYMBOL_LENGTH] = '\0';
+				change.previousPrice = latest.price;
+				change.previousVwap  = latest.vwap;
+				_waitingIndex[id] = _waiting.size();
+				_waiting.push_back(change);
+			}
+			StockChange& change = _waiting[_waitingIndex[id]];
+			change.cycle              = _cycle;
+			change.lastPrice          = price;
+			change.weightedStockPrice = vwap;
+			latest.price = price;
+			latest.vwap  = vwap;
+			latest.known = true;
+			_stats.changes++;
+			wake = true;
+		}
+	}
+	if (wake) {
+		_posted.notify_one();
+	}
+}
+
+void ChangeDispatcher::run()
+{
+	unique_lock<mutex> lock(_mutex);
+	for (;;) {
+		_posted.wait(lock, [this]() { return !_waiting.empty() || _stopping; });
+		if (_waiting.empty()) {
+			break;
+		}
+		StockChanges changes;
+		changes.swap(_waiting);
+		for (auto const& change : changes) {
+			_waitingIndex[change.id] = NO_CHANGE;
+		}
+		_delivering = true;
+		lock.unlock();
+
+		deliver(changes);
+
+		lock.lock();
+		_delivering = false;
+		_idle.notify_all();
+	}
+	_idle.notify_all();
+}
+
+void ChangeDispatcher::deliver(StockChanges const& changes)
+{
+	uint64_t     batches   = 0;
+	uint64_t     delivered = 0;
+	StockChanges batch;
+	lock_guard<mutex> guard(_subscriptionsMutex);
+	for (auto subscription : _subscriptions) {
+		if (subscription->removed) {
+			continue;
+		}
+		batch.clear();
+		vector<Values>& notified = subscription->notified;
+		for (auto const& change : changes) {
+			if (!subscription->filter &&
+				(change.id >= subscription->symbols.size() || !subscription->symbols[change.id])) {
+				continue;
+			}
+			if (change.id >= notified.size()) {
+				Values unknown = { 0, 0.0, false };
+				notified.resize(change.id + 1, unknown);
+			}
+			Values& previous = notified[change.id];
+			StockChange candidate = change;
+			if (previous.known) {
+				candidate.previousPrice = previous.price;
+				candidate.previousVwap  = previous.vwap;
+			}
+			if (!subscription->filter || subscription->filter(candidate)) {
+				previous.price = candidate.lastPrice;
+				previous.vwap  = candidate.weightedStockPrice;
+				previous.known = true;
+				batch.push_back(candidate);
+			} else if (!previous.known) {
+				// Later moves are measured from the first values seen
+				bool valued = candidate.previousPrice != 0 || candidate.previousVwap != 0.0;
+				previous.price = valued ? candidate.previousPrice : candidate.lastPrice;
+				previous.vwap  = valued ? candidate.previousVwap  : candidate.weightedStockPrice;
+				previous.known = true;
+			}
+		}
+		if (!batch.empty()) {
+			subscription->callback(batch);
+			batches++;
+			delivered += batch.size();
+		}
+	}
+	for (size_t i = _subscriptions.size(); i > 0; --i) {
+		if (_subscriptions[i - 1]->removed) {
+			delete _subscriptions[i - 1];
+			_subscriptions.erase(_subscriptions.begin() + (i - 1));
+		}
+	}
+	lock_guard<mutex> statsGuard(_mutex);
+	_stats.batches   += batches;
+	_stats.delivered += delivered;
+}
+
+void ChangeDispatcher::flush()
+{
+	if (onDispatcherThread()) {
+		return;
+	}
+	unique_lock<mutex> lock(_mutex);
+	_idle.wait(lock, [this]() { return (_waiting.empty() && !_delivering) || _stopping; });
+}
+
+DispatcherStats ChangeDispatcher::stats() const
+{
+	lock_guard<mutex> guard(_mutex);
+	return _stats;
+}
@@ -0,0 +1,154 @@
+#ifndef _CHANGE_DISPATCHER_H
+#define _CHANGE_DISPATCHER_H
+
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <stdint.h>
+#include "symbolTable.h"
+#include "tradeRecord.h"
+
+// File declares the notifications of the stock values changed by the
+// computations of a stock market. The computation only records the changes,
+// a dispatcher thread delivers them to the subscribers in batches.
+
+class StockTable;
+
+//! Change of the values of a stock
+struct StockChange
+{
+	SymbolId id;
+	char     symbol[MAX_SYMBOL_LENGTH + 1];  // NUL terminated, truncated, see 'id'
+	uint64_t cycle;                          // computation of the current values
+	int      previousPrice;                  // values last notified to the subscription
+	double   previousVwap;
+	int      lastPrice;                      // current values
+	double   weightedStockPrice;
+
+	//! Relative moves of the current values from the previous ones,
+	//! 0 when the previous value is 0
+	double priceMove() const {
+		return previousPrice != 0 ? (double) (lastPrice - previousPrice) / previousPrice : 0.0;
+	}
+	double vwapMove() const {
+		return previousVwap != 0.0 ? (weightedStockPrice - previousVwap) / previousVwap : 0.0;
+	}
+};
+
+typedef std::vector<StockChange>                 StockChanges;
+typedef unsigned                                 SubscriptionId;
+typedef std::function<bool(StockChange const&)>  ChangeFilter;
+typedef std::function<void(StockChanges const&)> ChangeCallback;
+
+//! Identifier never returned by 'subscribe'
+const SubscriptionId INVALID_SUBSCRIPTION = 0;
+
+//! Filters accepting the changes whose price or VWAP moved by more than
+//! 'percent' % since the values last notified
+ChangeFilter priceMoveAbove(double percent);
+ChangeFilter vwapMoveAbove (double percent);
+
+//! Statistics of a dispatcher
+struct DispatcherStats
+{
+	uint64_t cycles;      // computations posted
+	uint64_t changes;     // stock changes posted, before coalescing
+	uint64_t batches;     // batches delivered, all subscriptions
+	uint64_t delivered;   // stock changes delivered, all subscriptions
+};
+
+//! Dispatcher of the stock changes to the subscriptions.
+//! 'post' records the stocks whose price or VWAP changed and returns:
+//! callbacks run on the dispatcher thread, never in the computation.
+//! A stock has at most one change waiting: when the dispatcher is late,
+//! the changes of the following computations are coalesced, so a busy
+//! stock cannot flood a subscriber. Each subscription gets at most one
+//! batch per delivery, with the changes it accepts.
+//! A callback may unsubscribe, its own subscription or another one: the
+//! subscription gets no batch after the call.
+//! NOTE: 'subscribe' must not be called from a callback
+class ChangeDispatcher
+{
+	public:
+		ChangeDispatcher();
+
+		//! Deliver the remaining changes and stop the dispatcher thread
+		~ChangeDispatcher();
+
+		//! Subscribe to all changes of the given stocks
+		SubscriptionId subscribe(std::vector<SymbolId> const& ids, ChangeCallback const& callback);
+
+		//! Subscribe to the changes accepted by 'filter', called on the
+		//! dispatcher thread. The previous values of the changes given to the
+		//! filter are the values last notified to this subscription
+		SubscriptionId subscribe(ChangeFilter const& filter, ChangeCallback const& callback);
+
+		//! Returns false if the subscription is unknown. Waits for the
+		//! delivery in progress, unless called from a callback
+		bool unsubscribe(SubscriptionId id);
+
+		size_t numSubscriptions() const;
+
+		//! Record the changes of the given stocks after a computation.
+		//! Called by the computing thread
+		void post(std::vector<SymbolId> const& ids,
+				  StockTable            const& table,
+				  SymbolTable           const& symbols);
+
+		//! Wait until all the changes posted so far are delivered.
+		//! Returns at once when called from a callback: the delivery in
+		//! progress cannot end while its callback waits
+		void flush();
+
+		DispatcherStats stats() const;
+
+	private:
+		//! Values last posted or notified of a stock
+		struct Values {
+			int    price;
+			double vwap;
+			bool   known;
+		};
+
+		struct Subscription {
+			SubscriptionId      id;
+			ChangeFilter        filter;      // empty for subscriptions by symbol
+			std::vector<bool>   symbols;     // indexed by symbol identifier
+			ChangeCallback      callback;
+			std::vector<Values> notified;    // indexed by symbol identifier
+			bool                removed;     // by a callback, erased after the delivery
+		};
+
+		SubscriptionId add(Subscription* subscription);
+		bool onDispatcherThread() const { return std::this_thread::get_id() == _thread.get_id(); }
+		void run();
+		void deliver(StockChanges const& changes);
+
+		static const size_t NO_CHANGE = (size_t) -1;
+
+		mutable std::mutex          _mutex;           // guards the waiting changes
+		std::condition_variable     _posted;
+		std::condition_variable     _idle;
+		StockChanges                _waiting;
+		std::vector<size_t>         _waitingIndex;    // in '_waiting', indexed by symbol identifier
+		std::vector<Values>         _latest;          // indexed by symbol identifier
+		bool                        _delivering;
+		bool                        _stopping;
+		uint64_t                    _cycle;
+		DispatcherStats             _stats;
+
+		mutable std::mutex          _subscriptionsMutex;
+		std::vector<Subscription*>  _subscriptions;
+		SubscriptionId              _nextId;
+
+		std::thread                 _thread;
+
+	//! Disable copy constructor and
+	//! copy assignment operator
+	ChangeDispatcher(const ChangeDispatcher&);
+	ChangeDispatcher& operator=(const ChangeDispatcher&);
+};
+
+#endif
@@ -0,0 +1,259 @@
+#include "diagnostics.h"
+#include <chrono>
+#include <cstring>
+
+using namespace std;
+
+//! Copy a possibly NULL string into a fixed size field
+static void copyName(char* dest, const char* source)
+{
+	size_t length = source ? strnlen(source, DiagnosticEvent::NAME_SIZE - 1) : 0;
+	if (length > 0) {
+		memcpy(dest, source, length);
+	}
+	dest[length] = '\0';
+}
+
+static int64_t currentSecond()
+{
+	return chrono::duration_cast<chrono::seconds>(
+		chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+DiagnosticChannel::DiagnosticChannel(ostream& out,
+									 size_t   capacity,
+									 unsigned maxPerSecond) :
+									_out           (out),
+									_queue         (capacity),
+									_maxPerSecond  (maxPerSecond),
+									_writer        (),
+									_lifecycleMutex(),
+									_running       (false),
+									_wakeMutex     (),
+									_wakeUp        (),
+									_sleeping      (false),
+									_enabled       (true),
+									_reported      (0),
+									_dropped       (0),
+									_written       (0),
+									_suppressed    (0),
+									_consumed      (0)
+{
+	memset(_limits, 0, sizeof(_limits));
+}
+
+DiagnosticChannel::~DiagnosticChannel()
+{
+	stop();
+}
+
+void DiagnosticChannel::report(DiagnosticCode code,
+							   const char*    symbol,
+							   const char*    context,
+							   int64_t        value0,
+							   int64_t        value1,
+							   SymbolId       id)
+{
+	if (!enabled()) {
+		return;
+	}
+	DiagnosticEvent event;
+	event.code      = (uint16_t) code;
+	event.id        = id;
+	event.values[0] = value0;
+	event.values[1] = value1;
+	copyName(event.symbol,  symbol);
+	copyName(event.context, context);
+
+	if (!_running.load(memory_order_acquire)) {
+		start();
+	}
+	if (_queue.tryPush(event)) {
+		_reported.fetch_add(1, memory_order_release);
+		// Pairs with the fence of the writer going to sleep: either the
+		// writer sees the event, or this sees the writer sleeping
+		atomic_thread_fence(memory_order_seq_cst);
+		if (_sleeping.load(memory_order_relaxed)) {
+			wake();
+		}
+	} else {
+		_dropped.fetch_add(1, memory_order_relaxed);
+	}
+}
+
+void DiagnosticChannel::format(ostream& out, DiagnosticEvent const& event)
+{
+	switch (event.code) {
+		case DIAG_STOCK_NOT_ADDED:
+			out << "Stock '" << event.symbol << "' not added to stock markert '"
+				<< event.context << "'";
+			break;
+		case DIAG_TRADE_INVALID_SYMBOL:
+			out << "Cannot add trade '" << event.symbol
+				<< "' (invalid symbol or unregistered stock)";
+			break;
+		case DIAG_TRADE_INVALID_POINTER:
+			out << "Invalid trade pointer ";
+			break;
+		case DIAG_DIVIDEND_YIELD_NOT_COMPUTED:
+			out << "Cannot compute Dividend Yield for stock " << event.symbol
+				<< " due to invalid values";
+			break;
+		case DIAG_PE_RATIO_NOT_COMPUTED:
+			out << "Cannot compute P/E ratio for stock " << event.symbol
+				<< " due to invalid values";
+			break;
+		case DIAG_VWAP_NOT_COMPUTED:
+			out << "Volume Weighted Stock Price not computed";
+			break;
+		case DIAG_STOCK_NOT_TRADED:
+			out << "Stock '" << event.symbol << "' not yet traded on stock '"
+				<< event.context << "'";
+			break;
+		case DIAG_TRADE_ROW_MALFORMED:
+			out << "Malformed " << event.context << " trade row " << event.values[0]
+				<< " at byte " << event.values[1] << " ignored";
+			break;
+		default:
+			out << "Unknown diagnostic " << event.code;
+			break;
+	}
+}
+
+size_t DiagnosticChannel::writeBatch()
+{
+	DiagnosticEvent events[BATCH_SIZE];
+	size_t count = _queue.popBatch(events, BATCH_SIZE);
+	if (count > 0) {
+		int64_t  second  = currentSecond();
+		uint64_t written = 0;
+		for (size_t i = 0; i < count; ++i) {
+			DiagnosticEvent const& event = events[i];
+			CodeLimit& limit = _limits[event.code < NUM_DIAGNOSTIC_CODES ? event.code : 0];
+			if (limit.second != second) {
+				writeSuppressed(second, false);
+			}
+			if (limit.count < _maxPerSecond) {
+				limit.count++;
+				format(_out, event);
+				_out << '\n';
+				written++;
+			} else {
+				limit.suppressed++;
+				limit.last = event;
+			}
+		}
+		// A single flush per batch, not per message
+		_out.flush();
+		_written   .fetch_add(written,         memory_order_relaxed);
+		_suppressed.fetch_add(count - written, memory_order_relaxed);
+		_consumed  .fetch_add(count,           memory_order_release);
+	}
+	return count;
+}
+
+void DiagnosticChannel::writeSuppressed(int64_t second, bool all)
+{
+	bool wrote = false;
+	for (int code = 0; code < NUM_DIAGNOSTIC_CODES; ++code) {
+		CodeLimit& limit = _limits[code];
+		if (limit.second == second && !all) {
+			continue;
+		}
+		if (limit.suppressed > 0) {
+			_out << limit.suppressed << " diagnostics suppressed like: ";
+			format(_out, limit.last);
+			_out << '\n';
+			wrote = true;
+		}
+		limit.second     = second;
+		limit.count      = 0;
+		limit.suppressed = 0;
+	}
+	if (wrote) {
+		_out.flush();
+	}
+}
+
+void DiagnosticChannel::wake()
+{
+	lock_guard<mutex> guard(_wakeMutex);
+	_wakeUp.notify_one();
+}
+
+void DiagnosticChannel::run()
+{
+	while (_running.load(memory_order_acquire)) {
+		if (writeBatch() > 0) {
+			continue;
+		}
+		int64_t second = currentSecond();
+		writeSuppressed(second, false);
+
+		// Sleep until an event is reported, or until the end of the second
+		// when suppressed events are waiting to be counted
+		bool suppressed = false;
+		for (int code = 0; code < NUM_DIAGNOSTIC_CODES; ++code) {
+			suppressed = suppressed || _limits[code].suppressed > 0;
+		}
+		unique_lock<mutex> lock(_wakeMutex);
+		_sleeping.store(true, memory_order_relaxed);
+		atomic_thread_fence(memory_order_seq_cst);
+		auto ready = [this]() {
+			return _queue.size() > 0 || !_running.load(memory_order_acquire);
+		};
+		if (suppressed) {
+			_wakeUp.wait_until(lock, chrono::steady_clock::time_point(chrono::seconds(second + 1)), ready);
+		} else {
+			_wakeUp.wait(lock, ready);
+		}
+		_sleeping.store(false, memory_order_relaxed);
+	}
+	while (writeBatch() > 0) {
+	}
+	writeSuppressed(currentSecond(), true);
+}
+
+void DiagnosticChannel::start()
+{
+	lock_guard<mutex> guard(_lifecycleMutex);
+	if (!_running.load(memory_order_relaxed)) {
+		_running.store(true, memory_order_release);
+		_writer = thread(&DiagnosticChannel::run, this);
+	}
+}
+
+void DiagnosticChannel::stop()
+{
+	lock_guard<mutex> guard(_lifecycleMutex);
+	if (_running.load(memory_order_relaxed)) {
+		_running.store(false, memory_order_release);
+		wake();
+		_writer.join();
+	}
+}
+
+void DiagnosticChannel::flush()
+{
+	uint64_t reported = _reported.load(memory_order_acquire);
+	while (_running.load(memory_order_acquire) &&
+		   _consumed.load(memory_order_acquire) < reported) {
+		this_thread::sleep_for(chrono::microseconds(50));
+	}
+}
+
+DiagnosticStats DiagnosticChannel::stats() const
+{
+	DiagnosticStats result;
+	result.reported   = _reported  .load(memory_order_relaxed);
+	result.dropped    = _dropped   .load(memory_order_relaxed);
+	result.written    = _written   .load(memory_order_relaxed);
+	result.suppressed = _suppressed.load(memory_order_relaxed);
+	return result;
+}
+
+DiagnosticChannel& diagnostics()
+{
+	static DiagnosticChannel channel;
+	return channel;
+}
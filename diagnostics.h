@@ -0,0 +1,135 @@
+#ifndef _DIAGNOSTICS_H
+#define _DIAGNOSTICS_H
+
+#include "mpscQueue.h"
+#include "symbolTable.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+// File declares the asynchronous diagnostic channel of the stock market.
+// Hot paths push fixed size binary events and never format nor write:
+// a background thread formats the events and rate limits them per code.
+
+//! Kind of a diagnostic event, the meaning of its values depends on it
+enum DiagnosticCode {
+	DIAG_STOCK_NOT_ADDED,               // context: market name
+	DIAG_TRADE_INVALID_SYMBOL,          // empty symbol
+	DIAG_TRADE_INVALID_POINTER,
+	DIAG_DIVIDEND_YIELD_NOT_COMPUTED,   // values: price, last dividend
+	DIAG_PE_RATIO_NOT_COMPUTED,         // values: price, last dividend
+	DIAG_VWAP_NOT_COMPUTED,             // values: sum of price x quantity, sum of quantity
+	DIAG_STOCK_NOT_TRADED,              // context: market name
+	DIAG_TRADE_ROW_MALFORMED,           // context: file format, values: row, byte offset
+	NUM_DIAGNOSTIC_CODES
+};
+
+//! Fixed size diagnostic record, symbol and context are truncated
+struct DiagnosticEvent
+{
+	static const size_t NAME_SIZE = 16;
+
+	uint16_t code;
+	SymbolId id;                  // INVALID_SYMBOL when unknown
+	char     symbol [NAME_SIZE];
+	char     context[NAME_SIZE];
+	int64_t  values[2];
+};
+
+//! Counters of a diagnostic channel
+struct DiagnosticStats
+{
+	uint64_t reported;     // events queued
+	uint64_t dropped;      // events lost because the queue was full
+	uint64_t written;      // events formatted to the output
+	uint64_t suppressed;   // events over the rate limit
+};
+
+//! Asynchronous diagnostic channel.
+//! 'report' copies the event into a lock-free ring buffer, the writer thread
+//! is started by the first report and sleeps while the buffer is empty.
+//! Each code is written at most 'maxPerSecond' times per second, the number
+//! of suppressed events being written once the second is over.
+class DiagnosticChannel
+{
+	public:
+		DiagnosticChannel(std::ostream& out          = std::cerr,
+						  size_t        capacity     = 4096,
+						  unsigned      maxPerSecond = 100);
+		~DiagnosticChannel();
+
+		//! Queue an event, drops it if the queue is full.
+		//! Safe to call from many threads at once
+		void report(DiagnosticCode code,
+					const char*    symbol,
+					const char*    context = NULL,
+					int64_t        value0  = 0,
+					int64_t        value1  = 0,
+					SymbolId       id      = INVALID_SYMBOL);
+
+		//! Disabled channels ignore the reported events
+		bool enabled() const { return _enabled.load(std::memory_order_relaxed); }
+		void setEnabled(bool enabled) {
+			_enabled.store(enabled, std::memory_order_relaxed);
+		}
+
+		//! Wait until all the events reported so far are written
+		void flush();
+
+		//! Write the remaining events and stop the writer thread.
+		//! A later report starts it again
+		void stop();
+
+		DiagnosticStats stats() const;
+
+		//! Write an event as text, without new line
+		static void format(std::ostream& out, DiagnosticEvent const& event);
+
+	private:
+		//! Rate limit state of a code
+		struct CodeLimit {
+			int64_t         second;
+			unsigned        count;
+			uint64_t        suppressed;
+			DiagnosticEvent last;        // last suppressed event
+		};
+
+		void   start();
+		void   run();
+		void   wake();
+		size_t writeBatch();
+		void   writeSuppressed(int64_t second, bool all);
+
+		static const size_t BATCH_SIZE = 256;
+
+		std::ostream&               _out;
+		MpscQueue<DiagnosticEvent>  _queue;
+		unsigned                    _maxPerSecond;
+		CodeLimit                   _limits[NUM_DIAGNOSTIC_CODES];  // writer thread only
+		std::thread                 _writer;
+		std::mutex                  _lifecycleMutex;   // serializes 'start' and 'stop'
+		std::atomic<bool>           _running;
+		std::mutex                  _wakeMutex;
+		std::condition_variable     _wakeUp;           // the writer waits for events on it
+		std::atomic<bool>           _sleeping;
+		std::atomic<bool>           _enabled;
+		std::atomic<uint64_t>       _reported;
+		std::atomic<uint64_t>       _dropped;
+		std::atomic<uint64_t>       _written;
+		std::atomic<uint64_t>       _suppressed;
+		std::atomic<uint64_t>       _consumed;
+
+	//! Disable copy constructor and
+	//! copy assignment operator
+	DiagnosticChannel(const DiagnosticChannel&);
+	DiagnosticChannel& operator=(const DiagnosticChannel&);
+};
+
+//! Process wide channel, writing to std::cerr so the diagnostics do not
+//! interleave with the reports written to std::cout
+DiagnosticChannel& diagnostics();
+
+#endif
@@ -0,0 +1,82 @@
+#include "epochManager.h"
+#include <limits>
+#include <thread>
+
+using namespace std;
+
+EpochManager::EpochManager() :
+				_epoch  (1),
+				_retired()
+{
+	for (size_t i = 0; i < MAX_READERS; ++i) {
+		_slots[i].epoch.store(0, memory_order_relaxed);
+	}
+}
+
+EpochManager::~EpochManager()
+{
+	for (auto& retired : _retired) {
+		retired.reclaim();
+	}
+	_retired.clear();
+}
+
+size_t EpochManager::threadIndex()
+{
+	static atomic<size_t> nextIndex(0);
+	static thread_local size_t index = nextIndex.fetch_add(1, memory_order_relaxed) % MAX_READERS;
+	return index;
+}
+
+size_t EpochManager::enter()
+{
+	// Start from the slot of the thread, so readers rarely compete for a slot.
+	// The pinned epoch may be older than the current one when the slot is
+	// taken: it only delays the reclamation
+	size_t start = threadIndex();
+	for (;;) {
+		for (size_t i = 0; i < MAX_READERS; ++i) {
+			size_t   slot     = (start + i) % MAX_READERS;
+			uint64_t expected = 0;
+			if (_slots[slot].epoch.load(memory_order_relaxed) == 0 &&
+				_slots[slot].epoch.compare_exchange_strong(expected, _epoch.load())) {
+				return slot;
+			}
+		}
+		this_thread::yield();
+	}
+}
+
+void EpochManager::exit(size_t slot)
+{
+	_slots[slot].epoch.store(0, memory_order_release);
+}
+
+void EpochManager::retire(function<void()> const& reclaim)
+{
+	Retired retired = { _epoch.load(), reclaim };
+	_retired.push_back(retired);
+}
+
+size_t EpochManager::collect()
+{
+	// Readers entering from now on pin the new epoch and cannot see
+	// the objects retired so far
+	_epoch.fetch_add(1);
+
+	uint64_t oldest = numeric_limits<uint64_t>::max();
+	for (size_t i = 0; i < MAX_READERS; ++i) {
+		uint64_t pinned = _slots[i].epoch.load();
+		if (pinned != 0 && pinned < oldest) {
+			oldest = pinned;
+		}
+	}
+
+	size_t result = 0;
+	while (!_retired.empty() && _retired.front().epoch < oldest) {
+		_retired.front().reclaim();
+		_retired.pop_front();
+		result++;
+	}
+	return result;
+}
@@ -0,0 +1,92 @@
+#ifndef _EPOCH_MANAGER_H
+#define _EPOCH_MANAGER_H
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <cstddef>
+#include <stdint.h>
+
+// File declares the epoch based reclamation of the versions a writer
+// publishes to concurrent readers, without locks nor reference counts.
+// Readers pin the current epoch while they read. The writer retires the
+// objects it replaced with the current epoch, and frees them once every
+// reader which pinned that epoch or an older one is gone.
+
+//! Epochs of one writer and its readers
+class EpochManager
+{
+	public:
+		static const size_t MAX_READERS = 64;
+
+		EpochManager();
+
+		//! Reclaim all retired objects: no reader may be active
+		~EpochManager();
+
+		//! Reader side, lock free and safe from any thread.
+		//! Pin the current epoch, returns the slot to give back to 'exit'.
+		//! Waits when MAX_READERS readers are already active
+		size_t enter();
+		void   exit(size_t slot);
+
+		//! Writer side, from a single thread.
+		//! Retire an object new readers cannot reach anymore: 'reclaim'
+		//! is called once the readers which may still see it are gone
+		void retire(std::function<void()> const& reclaim);
+
+		//! Advance the epoch and reclaim the objects no reader can see.
+		//! Returns the number of objects reclaimed
+		size_t collect();
+
+		//! Accessing
+		uint64_t epoch     () const { return _epoch.load(std::memory_order_relaxed); }
+		size_t   numRetired() const { return _retired.size(); }
+
+	private:
+		//! Epoch pinned by a reader, 0 when the slot is free.
+		//! Padded to a cache line so readers barely share lines, without
+		//! over-aligning the stock market holding the manager
+		struct Slot {
+			std::atomic<uint64_t> epoch;
+			char                  padding[64 - sizeof(std::atomic<uint64_t>)];
+		};
+
+		struct Retired {
+			uint64_t              epoch;
+			std::function<void()> reclaim;
+		};
+
+		static size_t threadIndex();
+
+		std::atomic<uint64_t> _epoch;     // starts at 1
+		Slot                  _slots[MAX_READERS];
+		std::deque<Retired>   _retired;   // in retirement order
+
+	//! Disable copy constructor and
+	//! copy assignment operator
+	EpochManager(const EpochManager&);
+	EpochManager& operator=(const EpochManager&);
+};
+
+//! Pins the current epoch of a manager for the lifetime of a scope
+class EpochGuard
+{
+	public:
+		EpochGuard(EpochManager& epochs) :
+					_epochs(epochs),
+					_slot  (epochs.enter())
+					{}
+		~EpochGuard() {
+			_epochs.exit(_slot);
+		}
+
+	private:
+		EpochManager& _epochs;
+		size_t        _slot;
+
+	EpochGuard(const EpochGuard&);
+	EpochGuard& operator=(const EpochGuard&);
+};
+
+#endif
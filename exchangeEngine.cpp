@@ -0,0 +1,359 @@
+#include "exchangeEngine.h"
+#include "stockMarket.h"
+#include "stockUtil.h"
+#include <chrono>
+#include <cmath>
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+using namespace std;
+
+const size_t ExchangeEngine::NOT_DUAL;
+
+ExchangeEngine::ExchangeEngine(EngineOptions const& options) :
+					_options (options),
+					_workers (),
+					_routes  (),
+					_listings(),
+					_duals   (),
+					_numDuals(0),
+					_running (false),
+					_unrouted(0)
+					{}
+
+ExchangeEngine::~ExchangeEngine()
+{
+	stop();
+	for (auto worker : _workers) {
+		delete   worker->ingestor;
+		delete[] worker->partials.priceQuantities;
+		delete[] worker->partials.quantities;
+		delete   worker;
+	}
+}
+
+MarketId ExchangeEngine::addMarket(StockMarket& market)
+{
+	if (_running) {
+		return INVALID_MARKET;
+	}
+	Worker* worker = new Worker();
+	worker->market   = &market;
+	worker->ingestor = new TradeIngestor(market,
+										 _options.policy,
+										 _options.queueCapacity,
+										 _options.batchSize);
+	worker->running         .store(false);
+	worker->computeRequested.store(0);
+	worker->computeDone     .store(0);
+	worker->partials.sequence       .store(0);
+	worker->partials.vwapLogSum     .store(0.0);
+	worker->partials.numTradedStocks.store(0);
+	worker->partials.priceQuantities = NULL;
+	worker->partials.quantities      = NULL;
+	_workers.push_back(worker);
+	return (MarketId) (_workers.size() - 1);
+}
+
+StockMarket& ExchangeEngine::market(MarketId id) const
+{
+	return *_workers[id]->market;
+}
+
+size_t ExchangeEngine::numListings(const char* symbol) const
+{
+	SymbolId route = _routes.find(symbol);
+	return route != INVALID_SYMBOL ? _listings[route].size() : 0;
+}
+
+void ExchangeEngine::start()
+{
+	if (_running) {
+		return;
+	}
+
+	// Routes of the symbols of all markets, in market order: the first
+	// listing of a symbol is its primary market. Built anew on each start,
+	// the markets may have gained stocks since the previous one
+	_routes = SymbolTable();
+	_listings.clear();
+	_duals   .clear();
+	_numDuals = 0;
+	for (MarketId market = 0; market < _workers.size(); ++market) {
+		SymbolTable const& symbols = _workers[market]->market->symbols();
+		for (SymbolId id = 0; id < symbols.size(); ++id) {
+			SymbolId route = _routes.intern(symbols.name(id).c_str());
+			if (route >= _listings.size()) {
+				_listings.resize(route + 1);
+				_duals   .resize(route + 1, NOT_DUAL);
+			}
+			Listing listing = { market, id };
+			_listings[route].push_back(listing);
+		}
+	}
+	for (SymbolId route = 0; route < _listings.size(); ++route) {
+		if (_listings[route].size() > 1) {
+			_duals[route] = _numDuals++;
+		}
+	}
+
+	for (auto worker : _workers) {
+		Partials& partials = worker->partials;
+		delete[] partials.priceQuantities;
+		delete[] partials.quantities;
+		partials.priceQuantities = new atomic<int64_t>[_numDuals];
+		partials.quantities      = new atomic<int64_t>[_numDuals];
+		for (size_t dual = 0; dual < _numDuals; ++dual) {
+			partials.priceQuantities[dual].store(0);
+			partials.quantities     [dual].store(0);
+		}
+		worker->dualIds.assign(_numDuals, INVALID_SYMBOL);
+	}
+	for (SymbolId route = 0; route < _listings.size(); ++route) {
+		if (_duals[route] != NOT_DUAL) {
+			for (auto const& listing : _listings[route]) {
+				_workers[listing.market]->dualIds[_duals[route]] = listing.id;
+			}
+		}
+	}
+
+	_running = true;
+	for (MarketId id = 0; id < _workers.size(); ++id) {
+		_workers[id]->running.store(true, memory_order_release);
+		_workers[id]->thread = thread(&ExchangeEngine::run, this, id);
+	}
+}
+
+void ExchangeEngine::stop()
+{
+	if (!_running) {
+		return;
+	}
+	for (auto worker : _workers) {
+		worker->running.store(false, memory_order_release);
+	}
+	for (auto worker : _workers) {
+		worker->thread.join();
+	}
+	_running = false;
+}
+
+bool ExchangeEngine::push(TradeRecord const& record)
+{
+	SymbolId route = _routes.find(record.symbol);
+	if (route == INVALID_SYMBOL) {
+		_unrouted.fetch_add(1, memory_order_relaxed);
+		return false;
+	}
+	return dispatch(_listings[route].front(), record);
+}
+
+bool ExchangeEngine::push(MarketId market, TradeRecord const& record)
+{
+	SymbolId route = _routes.find(record.symbol);
+	if (route != INVALID_SYMBOL) {
+		for (auto const& listing : _listings[route]) {
+			if (listing.market == market) {
+				return dispatch(listing, record);
+			}
+		}
+	}
+	_unrouted.fetch_add(1, memory_order_relaxed);
+	return false;
+}
+
+bool ExchangeEngine::dispatch(Listing const& listing, TradeRecord const& record)
+{
+	// The market skips the symbol lookup given its own identifier
+	TradeRecord routed = record;
+	routed.id = listing.id;
+	return _workers[listing.market]->ingestor->push(routed);
+}
+
+void ExchangeEngine::computeAll(bool wait)
+{
+	if (!_running) {
+		// No worker: the markets belong to the calling thread
+		for (auto worker : _workers) {
+			worker->ingestor->drain();
+			compute(*worker);
+		}
+		return;
+	}
+	vector<uint64_t> requested(_workers.size());
+	for (size_t i = 0; i < _workers.size(); ++i) {
+		requested[i] = _workers[i]->computeRequested.fetch_add(1, memory_order_acq_rel) + 1;
+	}
+	if (!wait) {
+		return;
+	}
+	for (size_t i = 0; i < _workers.size(); ++i) {
+		while (_workers[i]->computeDone.load(memory_order_acquire) < requested[i]) {
+			this_thread::yield();
+		}
+	}
+}
+
+void ExchangeEngine::run(MarketId id)
+{
+	Worker& worker = *_workers[id];
+	if (_options.pinThreads) {
+		pin(id);
+	}
+
+	typedef chrono::steady_clock Clock;
+	chrono::milliseconds interval(_options.computeIntervalMs);
+	Clock::time_point    nextCompute = Clock::now() + interval;
+	int                  idle        = 0;
+	for (;;) {
+		bool   running = worker.running.load(memory_order_acquire);
+		size_t count   = worker.ingestor->poll();
+
+		uint64_t requested = worker.computeRequested.load(memory_order_acquire);
+		if (requested != worker.computeDone.load(memory_order_relaxed)) {
+			// Trades pushed before the request are all queued by now
+			worker.ingestor->drain();
+			compute(worker);
+			worker.computeDone.store(requested, memory_order_release);
+			idle = 0;
+			continue;
+		}
+		if (interval.count() > 0 && Clock::now() >= nextCompute) {
+			compute(worker);
+			nextCompute = Clock::now() + interval;
+		}
+
+		if (count > 0) {
+			idle = 0;
+		} else if (!running) {
+			break;
+		} else if (++idle < 64) {
+			this_thread::yield();
+		} else {
+			this_thread::sleep_for(chrono::microseconds(50));
+		}
+	}
+	compute(worker);
+}
+
+void ExchangeEngine::compute(Worker& worker)
+{
+	StockMarket& market = *worker.market;
+	market.computeStockValues();
+
+	// Sums of the dual listed symbols gathered before entering the write
+	// section, so readers retry as little as possible
+	time_t now = market.clock().now();
+	worker.dualSums.resize(_numDuals);
+	for (size_t dual = 0; dual < _numDuals; ++dual) {
+		SymbolId id = worker.dualIds[dual];
+		worker.dualSums[dual] = id != INVALID_SYMBOL ?
+								market.vwapSums(id, now - VWAP_WINDOW_SECONDS, now) : WindowSums();
+	}
+
+	Partials& partials = worker.partials;
+	uint64_t  sequence = partials.sequence.load(memory_order_relaxed);
+	partials.sequence.store(sequence + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	partials.vwapLogSum     .store(market.vwapLogSum(),      memory_order_relaxed);
+	partials.numTradedStocks.store(market.numTradedStocks(), memory_order_relaxed);
+	for (size_t dual = 0; dual < _numDuals; ++dual) {
+		partials.priceQuantities[dual].store(worker.dualSums[dual].priceQuantity, memory_order_relaxed);
+		partials.quantities     [dual].store(worker.dualSums[dual].quantity,      memory_order_relaxed);
+	}
+	partials.sequence.store(sequence + 2, memory_order_release);
+}
+
+void ExchangeEngine::pin(MarketId id)
+{
+#ifdef __linux__
+	unsigned numCpus = thread::hardware_concurrency();
+	if (numCpus > 0) {
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		CPU_SET(id % numCpus, &cpus);
+		pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+	}
+#else
+	(void) id;
+#endif
+}
+
+void ExchangeEngine::readPartials(Worker const& worker, double& vwapLogSum, int& numTradedStocks) const
+{
+	Partials const& partials = worker.partials;
+	uint64_t before, after;
+	do {
+		before          = partials.sequence.load(memory_order_acquire);
+		vwapLogSum      = partials.vwapLogSum     .load(memory_order_relaxed);
+		numTradedStocks = partials.numTradedStocks.load(memory_order_relaxed);
+		atomic_thread_fence(memory_order_acquire);
+		after           = partials.sequence.load(memory_order_relaxed);
+	} while ((before & 1) != 0 || before != after);
+}
+
+void ExchangeEngine::readDualSums(Worker const& worker, size_t dual, int64_t& priceQuantity, int64_t& quantity) const
+{
+	Partials const& partials = worker.partials;
+	uint64_t before, after;
+	do {
+		before        = partials.sequence.load(memory_order_acquire);
+		priceQuantity = partials.priceQuantities[dual].load(memory_order_relaxed);
+		quantity      = partials.quantities     [dual].load(memory_order_relaxed);
+		atomic_thread_fence(memory_order_acquire);
+		after         = partials.sequence.load(memory_order_relaxed);
+	} while ((before & 1) != 0 || before != after);
+}
+
+double ExchangeEngine::geometricMean() const
+{
+	double vwapLogSum      = 0.0;
+	int    numTradedStocks = 0;
+	for (auto worker : _workers) {
+		double logSum = 0.0;
+		int    count  = 0;
+		readPartials(*worker, logSum, count);
+		if (count > 0) {
+			vwapLogSum      += logSum;
+			numTradedStocks += count;
+		}
+	}
+	return numTradedStocks > 0 ? exp(vwapLogSum / numTradedStocks) : 0.0;
+}
+
+int ExchangeEngine::numTradedStocks() const
+{
+	int result = 0;
+	for (auto worker : _workers) {
+		double logSum = 0.0;
+		int    count  = 0;
+		readPartials(*worker, logSum, count);
+		result += count;
+	}
+	return result;
+}
+
+double ExchangeEngine::vwap(const char* symbol) const
+{
+	SymbolId route = _routes.find(symbol);
+	if (route == INVALID_SYMBOL || _duals[route] == NOT_DUAL) {
+		return 0.0;
+	}
+	size_t  dual          = _duals[route];
+	int64_t priceQuantity = 0;
+	int64_t quantity      = 0;
+	for (auto const& listing : _listings[route]) {
+		int64_t marketPriceQuantity = 0;
+		int64_t marketQuantity      = 0;
+		readDualSums(*_workers[listing.market], dual, marketPriceQuantity, marketQuantity);
+		priceQuantity += marketPriceQuantity;
+		quantity      += marketQuantity;
+	}
+	return quantity > 0 ? (double) priceQuantity / quantity : 0.0;
+}
+
+IngestStats ExchangeEngine::ingestStats(MarketId id) const
+{
+	return _workers[id]->ingestor->stats();
+}
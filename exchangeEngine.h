@@ -0,0 +1,159 @@
+#ifndef _EXCHANGE_ENGINE_H
+#define _EXCHANGE_ENGINE_H
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+#include "tradeIngestor.h"
+#include "symbolTable.h"
+#include "windowKernels.h"
+
+// File declares the engine running several stock markets side by side.
+// Each market is only touched by its own worker thread, fed by its own
+// ingestion queue. Cross-market aggregates are merged from the partial
+// sums each worker publishes after computing its market: readers never
+// take a lock nor wait for a worker.
+
+class StockMarket;
+
+typedef unsigned MarketId;
+
+//! Identifier returned for unknown markets
+const MarketId INVALID_MARKET = (MarketId) -1;
+
+//! Engine options
+struct EngineOptions
+{
+	EngineOptions() : policy(BACKPRESSURE_BLOCK),
+					  queueCapacity(TradeIngestor::DEFAULT_CAPACITY),
+					  batchSize(TradeIngestor::DEFAULT_BATCH_SIZE),
+					  computeIntervalMs(0),
+					  pinThreads(false) {}
+
+	BackpressurePolicy policy;             // of the ingestion queues
+	size_t             queueCapacity;      // trades per market
+	size_t             batchSize;
+	unsigned           computeIntervalMs;  // workers compute on their own every N ms, 0 on request only
+	bool               pinThreads;         // pin worker i to CPU i modulo the number of CPUs (Linux)
+};
+
+//! Engine hosting many stock markets, one worker thread per market.
+//! Markets are registered and filled with their stocks before 'start';
+//! from 'start' to 'stop', a market must only be modified by its worker.
+//! Once stopped, markets and stocks may be added again: each 'start'
+//! routes the symbols of all markets anew.
+//! A symbol listed on several markets is dual listed: trades routed by
+//! symbol go to its first market, trades of the other listings are pushed
+//! to their market explicitly.
+class ExchangeEngine
+{
+	public:
+		ExchangeEngine(EngineOptions const& options = EngineOptions());
+
+		//! Stop the workers
+		~ExchangeEngine();
+
+		//! Host a market, not owned by the engine. Returns its identifier,
+		//! or INVALID_MARKET once started
+		MarketId addMarket(StockMarket& market);
+
+		//! Accessing
+		size_t       numMarkets() const { return _workers.size(); }
+		StockMarket& market(MarketId id) const;
+		bool         running() const { return _running; }
+
+		//! Number of markets listing a symbol, known once started
+		size_t numListings(const char* symbol) const;
+
+		//! Route the stock symbols of all markets and start the workers
+		void start();
+
+		//! Apply the trades still queued, compute the requested values,
+		//! then stop the workers
+		void stop();
+
+		//! Push a trade to the first market listing its symbol, or to the given
+		//! market. Safe to call from many threads at once once started.
+		//! Returns false if no market lists the symbol or the trade was dropped
+		bool push(TradeRecord const& record);
+		bool push(MarketId market, TradeRecord const& record);
+
+		//! Ask every worker to apply the trades queued so far and compute its
+		//! market, then optionally wait for all of them
+		void computeAll(bool wait = true);
+
+		//! Geometric Mean of the 'Volume Weighted Stock Price' of the traded
+		//! stocks of all markets, merged from the last computation of each market
+		double geometricMean() const;
+		int    numTradedStocks() const;
+
+		//! 'Volume Weighted Stock Price' of a dual listed symbol over the trades
+		//! of all its markets in their last VWAP window, 0 if the symbol is not
+		//! dual listed or not traded
+		double vwap(const char* symbol) const;
+
+		//! Ingestion counters of a market
+		IngestStats ingestStats(MarketId id) const;
+
+		//! Trades pushed for a symbol no market lists
+		size_t numUnrouted() const { return _unrouted.load(std::memory_order_relaxed); }
+
+	private:
+		//! Market of a listing and the symbol identifier in this market
+		struct Listing {
+			MarketId market;
+			SymbolId id;
+		};
+
+		//! Values published by a worker after each computation.
+		//! Sequence lock: the sequence is odd while the worker writes,
+		//! readers retry until they read an even and unchanged sequence.
+		//! All fields are atomics, read and written relaxed
+		struct Partials {
+			std::atomic<uint64_t>  sequence;
+			std::atomic<double>    vwapLogSum;
+			std::atomic<int>       numTradedStocks;
+			std::atomic<int64_t>*  priceQuantities;   // indexed by dual listing
+			std::atomic<int64_t>*  quantities;
+		};
+
+		struct Worker {
+			StockMarket*            market;
+			TradeIngestor*          ingestor;
+			std::thread             thread;
+			std::atomic<bool>       running;
+			std::atomic<uint64_t>   computeRequested;
+			std::atomic<uint64_t>   computeDone;
+			std::vector<SymbolId>   dualIds;          // indexed by dual listing, INVALID_SYMBOL if not listed
+			std::vector<WindowSums> dualSums;         // scratch of 'compute'
+			Partials                partials;
+		};
+
+		void run     (MarketId id);
+		void compute (Worker& worker);
+		void pin     (MarketId id);
+		bool dispatch(Listing const& listing, TradeRecord const& record);
+
+		//! Read the partials of a worker, consistent with one computation
+		void readPartials(Worker const& worker, double& vwapLogSum, int& numTradedStocks) const;
+		void readDualSums(Worker const& worker, size_t dual, int64_t& priceQuantity, int64_t& quantity) const;
+
+		EngineOptions                     _options;
+		std::vector<Worker*>              _workers;    // indexed by market identifier
+		SymbolTable                       _routes;     // symbols of all markets, read only once started
+		std::vector<std::vector<Listing>> _listings;   // indexed by route
+		std::vector<size_t>               _duals;      // dual listing of each route, or NOT_DUAL
+		size_t                            _numDuals;
+		bool                              _running;
+		std::atomic<size_t>               _unrouted;
+
+		static const size_t NOT_DUAL = (size_t) -1;
+
+	//! Disable copy constructor and
+	//! copy assignment operator
+	ExchangeEngine(const ExchangeEngine&);
+	ExchangeEngine& operator=(const ExchangeEngine&);
+};
+
+#endif
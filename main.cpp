@@ -27,6 +27,10 @@ int main(int argc, char** argv) {
 	// Should not crash!
 	frankfurt.computeStockValues();	
 	frankfurt.printInfo         ();
+	cout << endl << endl;
+	
+	// Test the components behind the stock markets
+	test.checkComponents();
 	
 	return 0;
 }
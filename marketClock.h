@@ -0,0 +1,64 @@
+#ifndef _MARKET_CLOCK_H
+#define _MARKET_CLOCK_H
+
+#include "time.h"
+
+//! Source of the current time of a stock market
+enum ClockMode {
+	CLOCK_WALL,     // system time
+	CLOCK_MANUAL,   // time set by the application, for tests and simulations
+	CLOCK_EVENT     // timestamp of the most recent trade added, for replays
+};
+
+//! Clock used by a stock market to evaluate its VWAP windows.
+//! Only the wall clock reads the system time: manual and event clocks
+//! make the computations deterministic and cost no system call.
+//! NOTE: VWAP windows expect the time to never go backward, the manual
+//! time must only be advanced
+class MarketClock
+{
+	public:
+		MarketClock(ClockMode mode = CLOCK_WALL) :
+					_mode       (mode),
+					_manualTime (0),
+					_eventTime  (0)
+					{}
+
+		//! Accessing
+		ClockMode mode     () const { return _mode;      }
+		time_t    eventTime() const { return _eventTime; }
+
+		//! Current time in the clock mode
+		time_t now() const {
+			switch (_mode) {
+				case CLOCK_MANUAL: return _manualTime;
+				case CLOCK_EVENT:  return _eventTime;
+				case CLOCK_WALL:
+				default:           return time(NULL);
+			}
+		}
+
+		//! Setting
+		void setMode(ClockMode mode) { _mode = mode; }
+
+		//! Set or advance the manual time
+		void set    (time_t now)     { _manualTime  = now;     }
+		void advance(time_t seconds) { _manualTime += seconds; }
+
+		//! Record the time of an event, the event time only moves forward
+		void observe(time_t timestamp) {
+			if (timestamp > _eventTime) {
+				_eventTime = timestamp;
+			}
+		}
+
+		//! Forget the events observed so far
+		void resetEventTime(time_t timestamp = 0) { _eventTime = timestamp; }
+
+	private:
+		ClockMode _mode;
+		time_t    _manualTime;
+		time_t    _eventTime;   // most recent event
+};
+
+#endif
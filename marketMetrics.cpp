@@ -0,0 +1,215 @@
+#include "marketMetrics.h"
+#include <iostream>
+#include <cstring>
+
+using namespace std;
+
+const char* metricsCounterName(MetricsCounter counter)
+{
+	switch (counter) {
+		case COUNTER_TRADES_ACCEPTED:   return "trades accepted";
+		case COUNTER_TRADES_REJECTED:   return "trades rejected";
+		case COUNTER_TRADES_EXPIRED:    return "trades expired";
+		case COUNTER_VWAP_NOT_COMPUTED: return "VWAP not computed";
+		case COUNTER_STOCKS_EVALUATED:  return "stocks evaluated";
+		case COUNTER_COMPUTE_CYCLES:    return "compute cycles";
+		default:                        return "";
+	}
+}
+
+const char* metricsLatencyName(MetricsLatency latency)
+{
+	switch (latency) {
+		case LATENCY_ADD_TRADE:            return "addTrade";
+		case LATENCY_COMPUTE_STOCK_VALUES: return "computeStockValues";
+		default:                           return "";
+	}
+}
+
+LatencyHistogram::LatencyHistogram():
+				_count(0),
+				_total(0),
+				_max  (0)
+{
+	memset(_counts, 0, sizeof(_counts));
+}
+
+unsigned LatencyHistogram::bucketOf(uint64_t value)
+{
+	// Values below SUB_BUCKETS are exact, the others keep
+	// their SUB_BUCKET_BITS most significant bits
+	if (value < SUB_BUCKETS) {
+		return (unsigned) value;
+	}
+	unsigned shift     = 63 - __builtin_clzll(value) - SUB_BUCKET_BITS;
+	unsigned subBucket = (unsigned) (value >> shift) - SUB_BUCKETS;
+	return (shift + 1) * SUB_BUCKETS + subBucket;
+}
+
+uint64_t LatencyHistogram::bucketLimit(unsigned bucket)
+{
+	unsigned magnitude = bucket / SUB_BUCKETS;
+	uint64_t subBucket = bucket % SUB_BUCKETS;
+	if (magnitude == 0) {
+		return subBucket;
+	}
+	uint64_t lowest = (SUB_BUCKETS + subBucket) << (magnitude - 1);
+	return lowest + (1ULL << (magnitude - 1)) - 1;
+}
+
+void LatencyHistogram::record(uint64_t value)
+{
+	_counts[bucketOf(value)]++;
+	_count++;
+	_total += value;
+	if (value > _max) {
+		_max = value;
+	}
+}
+
+void LatencyHistogram::merge(LatencyHistogram const& other)
+{
+	for (unsigned i = 0; i < NUM_BUCKETS; ++i) {
+		_counts[i] += other._counts[i];
+	}
+	_count += other._count;
+	_total += other._total;
+	if (other._max > _max) {
+		_max = other._max;
+	}
+}
+
+uint64_t LatencyHistogram::percentile(double percent) const
+{
+	uint64_t result = 0;
+	if (_count > 0) {
+		uint64_t rank = (uint64_t) (percent / 100.0 * _count + 0.5);
+		if (rank < 1) {
+			rank = 1;
+		}
+		uint64_t seen = 0;
+		for (unsigned i = 0; i < NUM_BUCKETS; ++i) {
+			seen += _counts[i];
+			if (seen >= rank) {
+				result = bucketLimit(i);
+				break;
+			}
+		}
+		if (result > _max) {
+			result = _max;
+		}
+	}
+	return result;
+}
+
+MetricsSnapshot::MetricsSnapshot():
+				latencies()
+{
+	memset(counters, 0, sizeof(counters));
+}
+
+void MetricsSnapshot::merge(MetricsSnapshot const& other)
+{
+	for (int i = 0; i < NUM_METRICS_COUNTERS; ++i) {
+		counters[i] += other.counters[i];
+	}
+	for (int i = 0; i < NUM_METRICS_LATENCIES; ++i) {
+		latencies[i].merge(other.latencies[i]);
+	}
+}
+
+void MetricsSnapshot::printInfo() const
+{
+	for (int i = 0; i < NUM_METRICS_COUNTERS; ++i) {
+		cout << metricsCounterName((MetricsCounter) i) << ": " << counters[i] << endl;
+	}
+	for (int i = 0; i < NUM_METRICS_LATENCIES; ++i) {
+		LatencyHistogram const& histogram = latencies[i];
+		cout << metricsLatencyName((MetricsLatency) i) << " (ns): count " << histogram.count()
+			 << " mean "  << histogram.mean()
+			 << " p50 "   << histogram.percentile(50)
+			 << " p99 "   << histogram.percentile(99)
+			 << " p99.9 " << histogram.percentile(99.9)
+			 << " max "   << histogram.max() << endl;
+	}
+}
+
+MarketMetrics::MarketMetrics()
+{
+	for (unsigned i = 0; i < MAX_THREAD_SLOTS; ++i) {
+		_slots[i].store(NULL, memory_order_relaxed);
+	}
+}
+
+MarketMetrics::~MarketMetrics()
+{
+	for (unsigned i = 0; i < MAX_THREAD_SLOTS; ++i) {
+		delete _slots[i].load(memory_order_relaxed);
+	}
+}
+
+unsigned MarketMetrics::threadIndex()
+{
+	static atomic<unsigned>  nextIndex(0);
+	static thread_local unsigned index = nextIndex.fetch_add(1, memory_order_relaxed) % MAX_THREAD_SLOTS;
+	return index;
+}
+
+MarketMetrics::Slot& MarketMetrics::createSlot()
+{
+	Slot* slot = new Slot();
+	for (int i = 0; i < NUM_METRICS_COUNTERS; ++i) {
+		slot->counters[i].store(0, memory_order_relaxed);
+	}
+	for (int i = 0; i < NUM_METRICS_LATENCIES; ++i) {
+		for (unsigned j = 0; j < LatencyHistogram::NUM_BUCKETS; ++j) {
+			slot->buckets[i][j].store(0, memory_order_relaxed);
+		}
+		slot->totals[i].store(0, memory_order_relaxed);
+		slot->maxima[i].store(0, memory_order_relaxed);
+	}
+
+	// Threads sharing the index may race to create the slot
+	Slot* expected = NULL;
+	if (!_slots[threadIndex()].compare_exchange_strong(expected, slot, memory_order_acq_rel)) {
+		delete slot;
+		slot = expected;
+	}
+	return *slot;
+}
+
+void MarketMetrics::record(MetricsLatency latency, uint64_t nanoseconds)
+{
+	Slot& current = slot();
+	current.buckets[latency][LatencyHistogram::bucketOf(nanoseconds)].fetch_add(1, memory_order_relaxed);
+	current.totals [latency].fetch_add(nanoseconds, memory_order_relaxed);
+	uint64_t max = current.maxima[latency].load(memory_order_relaxed);
+	while (nanoseconds > max &&
+		   !current.maxima[latency].compare_exchange_weak(max, nanoseconds, memory_order_relaxed)) {
+	}
+}
+
+MetricsSnapshot MarketMetrics::snapshot() const
+{
+	MetricsSnapshot result;
+	for (unsigned s = 0; s < MAX_THREAD_SLOTS; ++s) {
+		const Slot* slot = _slots[s].load(memory_order_acquire);
+		if (!slot) {
+			continue;
+		}
+		for (int i = 0; i < NUM_METRICS_COUNTERS; ++i) {
+			result.counters[i] += slot->counters[i].load(memory_order_relaxed);
+		}
+		for (int i = 0; i < NUM_METRICS_LATENCIES; ++i) {
+			LatencyHistogram histogram;
+			for (unsigned j = 0; j < LatencyHistogram::NUM_BUCKETS; ++j) {
+				histogram._counts[j] = slot->buckets[i][j].load(memory_order_relaxed);
+				histogram._count    += histogram._counts[j];
+			}
+			histogram._total = slot->totals[i].load(memory_order_relaxed);
+			histogram._max   = slot->maxima[i].load(memory_order_relaxed);
+			result.latencies[i].merge(histogram);
+		}
+	}
+	return result;
+}
@@ -0,0 +1,179 @@
+#ifndef _MARKET_METRICS_H
+#define _MARKET_METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+//! Metrics are compiled in unless built with -DSTOCK_MARKET_METRICS=0,
+//! in which case the recording macros below expand to nothing
+#ifndef STOCK_MARKET_METRICS
+#define STOCK_MARKET_METRICS 1
+#endif
+
+//! Counters of the stock market hot paths
+enum MetricsCounter {
+	COUNTER_TRADES_ACCEPTED,
+	COUNTER_TRADES_REJECTED,      // null trade, empty or unregistered symbol
+	COUNTER_TRADES_EXPIRED,       // dropped by the retention policy
+	COUNTER_VWAP_NOT_COMPUTED,    // stock not yet traded or empty VWAP window
+	COUNTER_STOCKS_EVALUATED,
+	COUNTER_COMPUTE_CYCLES,
+	NUM_METRICS_COUNTERS
+};
+
+//! Timed operations of the stock market
+enum MetricsLatency {
+	LATENCY_ADD_TRADE,
+	LATENCY_COMPUTE_STOCK_VALUES,
+	NUM_METRICS_LATENCIES
+};
+
+//! Name of a counter or timed operation, as printed in reports
+const char* metricsCounterName(MetricsCounter counter);
+const char* metricsLatencyName(MetricsLatency latency);
+
+//! HDR style histogram of latencies in nanoseconds.
+//! Values are bucketed by power of two, each power of two being split
+//! in SUB_BUCKETS linear buckets: the relative error of a percentile
+//! is below 1 / SUB_BUCKETS whatever the magnitude of the value.
+class LatencyHistogram
+{
+	public:
+		static const unsigned SUB_BUCKET_BITS = 4;
+		static const unsigned SUB_BUCKETS     = 1 << SUB_BUCKET_BITS;
+		static const unsigned MAGNITUDES      = 64 - SUB_BUCKET_BITS + 1;
+		static const unsigned NUM_BUCKETS     = MAGNITUDES * SUB_BUCKETS;
+
+		LatencyHistogram();
+
+		//! Accessing
+		uint64_t count() const { return _count; }
+		uint64_t total() const { return _total; }
+		uint64_t max  () const { return _max;   }
+		double   mean () const { return _count ? (double) _total / _count : 0.0; }
+		uint64_t bucketCount(unsigned bucket) const { return _counts[bucket]; }
+
+		//! Smallest recorded value (rounded up to its bucket)
+		//! such as 'percent' % of the values are lower or equal
+		uint64_t percentile(double percent) const;
+
+		void record(uint64_t value);
+		void merge (LatencyHistogram const& other);
+
+		//! Bucket of a value and highest value of a bucket
+		static unsigned bucketOf   (uint64_t value);
+		static uint64_t bucketLimit(unsigned bucket);
+
+	private:
+		uint64_t _counts[NUM_BUCKETS];
+		uint64_t _count;
+		uint64_t _total;
+		uint64_t _max;
+
+	friend class MarketMetrics;
+};
+
+//! Values of all counters and histograms at a given time,
+//! summed over the threads which recorded them
+struct MetricsSnapshot
+{
+	MetricsSnapshot();
+
+	uint64_t         counters [NUM_METRICS_COUNTERS];
+	LatencyHistogram latencies[NUM_METRICS_LATENCIES];
+
+	uint64_t                counter(MetricsCounter counter) const { return counters [counter]; }
+	LatencyHistogram const& latency(MetricsLatency latency) const { return latencies[latency]; }
+
+	//! Add the values of another snapshot
+	void merge(MetricsSnapshot const& other);
+
+	//! Print counters and latency percentiles
+	void printInfo() const;
+};
+
+//! Metrics of a stock market.
+//! Every thread records into its own slot, so recording is a couple of
+//! uncontended relaxed atomic additions, and a snapshot sums the slots.
+//! Slots are allocated on the first record of a thread.
+class MarketMetrics
+{
+	public:
+		static const unsigned MAX_THREAD_SLOTS = 64;
+
+		MarketMetrics();
+		~MarketMetrics();
+
+		void count (MetricsCounter counter, uint64_t value = 1) {
+			slot().counters[counter].fetch_add(value, std::memory_order_relaxed);
+		}
+		void record(MetricsLatency latency, uint64_t nanoseconds);
+
+		//! Sum of the slots, may be taken while other threads record
+		MetricsSnapshot snapshot() const;
+
+		//! Monotonic time in nanoseconds used by the timers
+		static uint64_t now() {
+			return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+	private:
+		struct Slot {
+			std::atomic<uint64_t> counters[NUM_METRICS_COUNTERS];
+			std::atomic<uint64_t> buckets [NUM_METRICS_LATENCIES][LatencyHistogram::NUM_BUCKETS];
+			std::atomic<uint64_t> totals  [NUM_METRICS_LATENCIES];
+			std::atomic<uint64_t> maxima  [NUM_METRICS_LATENCIES];
+		};
+
+		//! Slot of the calling thread, threads beyond MAX_THREAD_SLOTS share slots
+		Slot& slot() {
+			Slot* result = _slots[threadIndex()].load(std::memory_order_acquire);
+			return result ? *result : createSlot();
+		}
+		Slot& createSlot();
+
+		static unsigned threadIndex();
+
+		std::atomic<Slot*> _slots[MAX_THREAD_SLOTS];
+
+	//! Disable copy constructor and
+	//! copy assignment operator
+	MarketMetrics(const MarketMetrics&);
+	MarketMetrics& operator=(const MarketMetrics&);
+};
+
+//! Times a scope into a latency histogram
+class MetricsTimer
+{
+	public:
+		MetricsTimer(MarketMetrics& metrics, MetricsLatency latency):
+					_metrics(metrics),
+					_latency(latency),
+					_start  (MarketMetrics::now())
+					{}
+		~MetricsTimer() {
+			_metrics.record(_latency, MarketMetrics::now() - _start);
+		}
+
+	private:
+		MarketMetrics& _metrics;
+		MetricsLatency _latency;
+		uint64_t       _start;
+
+	MetricsTimer(const MetricsTimer&);
+	MetricsTimer& operator=(const MetricsTimer&);
+};
+
+//! Recording macros, removed when metrics are compiled out
+#if STOCK_MARKET_METRICS
+#define METRICS_COUNT(metrics, counter, value) (metrics).count((counter), (value))
+#define METRICS_TIME_SCOPE(metrics, latency)   MetricsTimer metricsTimer_##latency((metrics), (latency))
+#else
+#define METRICS_COUNT(metrics, counter, value) ((void) 0)
+#define METRICS_TIME_SCOPE(metrics, latency)   ((void) 0)
+#endif
+
+#endif
@@ -0,0 +1,118 @@
+#include "marketReplay.h"
+#include "stockMarket.h"
+#include "tradeJournal.h"
+#include <chrono>
+
+using namespace std;
+
+static double wallSeconds()
+{
+	return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+MarketReplay::MarketReplay(StockMarket& market, ReplayOptions const& options) :
+						_market     (market),
+						_options    (options),
+						_callback   (),
+						_nextCompute(0),
+						_startTime  (0.0),
+						_savedMode  (CLOCK_WALL)
+						{}
+
+void MarketReplay::begin(ReplayStats& stats)
+{
+	stats        = ReplayStats();
+	_nextCompute = 0;
+	_startTime   = wallSeconds();
+	_savedMode   = _market.clock().mode();
+	_market.clock().setMode(CLOCK_EVENT);
+}
+
+void MarketReplay::end(ReplayStats& stats)
+{
+	if (stats.trades > 0) {
+		compute(_market.clock().eventTime(), stats);
+	}
+	stats.wallSeconds = wallSeconds() - _startTime;
+	_market.clock().setMode(_savedMode);
+}
+
+void MarketReplay::compute(time_t now, ReplayStats& stats)
+{
+	_market.clock().observe(now);
+	_market.computeStockValues();
+	stats.computations++;
+	if (_callback) {
+		_callback(_market, _market.clock().now());
+	}
+}
+
+void MarketReplay::replay(TradeSpan trades, ReplayStats& stats)
+{
+	const TradeRecord* first = trades.begin();
+	while (first != trades.end()) {
+		if (stats.trades == 0) {
+			stats.firstEventTime = first->timestamp;
+			if (_options.computeInterval > 0) {
+				_nextCompute = first->timestamp - first->timestamp % _options.computeInterval
+							 + _options.computeInterval;
+			}
+		}
+		// Trades before the next computation are added as one span
+		const TradeRecord* last = first;
+		while (last != trades.end() &&
+			   (_options.computeInterval == 0 || last->timestamp < _nextCompute)) {
+			++last;
+		}
+		if (last != first) {
+			stats.added  += _market.addTrades(TradeSpan(first, last - first));
+			stats.trades += last - first;
+			stats.lastEventTime = (last - 1)->timestamp;
+		}
+		if (last != trades.end()) {
+			// Compute at each interval crossed before the next trade
+			compute(_nextCompute, stats);
+			_nextCompute += _options.computeInterval;
+			if (last->timestamp >= _nextCompute) {
+				// Skip the intervals without trades
+				_nextCompute = last->timestamp - last->timestamp % _options.computeInterval
+							 + _options.computeInterval;
+			}
+		}
+		first = last;
+	}
+}
+
+ReplayStats MarketReplay::run(TradeSpan trades)
+{
+	ReplayStats stats;
+	begin (stats);
+	replay(trades, stats);
+	end   (stats);
+	return stats;
+}
+
+ReplayStats MarketReplay::run(TradeJournal const& journal)
+{
+	ReplayStats stats;
+	begin(stats);
+
+	// Replays the decoded trades, computing on the way
+	struct Replayer : JournalVisitor {
+		Replayer(MarketReplay& r, ReplayStats& s) : replay(r), stats(s) {}
+		void stock (const Stock* stock) { replay._market.addStock(stock); }
+		void trades(TradeSpan trades)   { replay.replay(trades, stats); }
+		MarketReplay& replay;
+		ReplayStats&  stats;
+	};
+
+	// The replayed trades must not be journaled again
+	TradeJournal* attached = _market.journal();
+	_market.setJournal(NULL);
+	Replayer replayer(*this, stats);
+	journal.visit(replayer, _options.batchSize);
+	_market.setJournal(attached);
+
+	end(stats);
+	return stats;
+}
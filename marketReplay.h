@@ -0,0 +1,84 @@
+#ifndef _MARKET_REPLAY_H
+#define _MARKET_REPLAY_H
+
+#include "tradeRecord.h"
+#include "marketClock.h"
+#include <functional>
+
+// File declares the driver replaying recorded trades through a stock market
+// as fast as possible, the VWAP windows being evaluated in event time:
+// a trading day is backtested in the time needed to ingest it.
+
+class StockMarket;
+class TradeJournal;
+
+//! Replay options
+struct ReplayOptions
+{
+	ReplayOptions() : computeInterval(1), batchSize(4096) {}
+
+	time_t computeInterval;   // event seconds between two computations, 0 to compute at the end only
+	size_t batchSize;         // trades converted at once when replaying a journal
+};
+
+//! Replay statistics
+struct ReplayStats
+{
+	ReplayStats() : trades(0), added(0), computations(0),
+					firstEventTime(0), lastEventTime(0), wallSeconds(0.0) {}
+
+	size_t trades;            // trades replayed
+	size_t added;             // trades accepted by the market
+	size_t computations;      // calls to 'computeStockValues'
+	time_t firstEventTime;
+	time_t lastEventTime;
+	double wallSeconds;
+
+	//! Event time replayed per wall clock second
+	double speedup() const {
+		return wallSeconds > 0.0 ? (lastEventTime - firstEventTime) / wallSeconds : 0.0;
+	}
+};
+
+//! Replays trades sorted by timestamp through a stock market.
+//! The market clock is switched to event time during the replay and the
+//! stock values are computed each time the event time crosses a multiple
+//! of the compute interval, at that time, then once at the end.
+//! The clock mode of the market is restored after the replay.
+class MarketReplay
+{
+	public:
+		//! Called after each computation with the event time of the computation
+		typedef std::function<void(StockMarket&, time_t)> ComputeCallback;
+
+		MarketReplay(StockMarket& market, ReplayOptions const& options = ReplayOptions());
+
+		//! Set the function called after each computation
+		void onCompute(ComputeCallback const& callback) { _callback = callback; }
+
+		//! Replay trades, returns the statistics of this replay
+		ReplayStats run(TradeSpan trades);
+
+		//! Replay the stocks and trades of a journal
+		ReplayStats run(TradeJournal const& journal);
+
+	private:
+		void begin (ReplayStats& stats);
+		void end   (ReplayStats& stats);
+		void replay(TradeSpan trades, ReplayStats& stats);
+		void compute(time_t now, ReplayStats& stats);
+
+		StockMarket&    _market;
+		ReplayOptions   _options;
+		ComputeCallback _callback;
+		time_t          _nextCompute;   // event time of the next computation
+		double          _startTime;
+		ClockMode       _savedMode;     // clock mode restored after the replay
+
+	//! Disable copy constructor and
+	//! copy assignment operator
+	MarketReplay(const MarketReplay&);
+	MarketReplay& operator=(const MarketReplay&);
+};
+
+#endif
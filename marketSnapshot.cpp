@@ -0,0 +1,271 @@
+#include "stockMarket.h"
+#include "marketSnapshot.h"
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+// Timestamps are stored as 64 bits integers and copied as is
+static_assert(sizeof(time_t) == sizeof(int64_t), "snapshots need 64 bits time_t");
+
+static const char SNAPSHOT_MAGIC[8] = { 'S', 'S', 'M', 'S', 'N', 'A', 'P', '\0' };
+
+static uint64_t align8(uint64_t offset)
+{
+	return (offset + 7) & ~(uint64_t) 7;
+}
+
+//! Write 'size' bytes then pad the file up to 'end'
+static void writeAt(ofstream& out, uint64_t end, const void* data, size_t size)
+{
+	static const char zeros[8] = { 0 };
+	out.write(static_cast<const char*>(data), size);
+	uint64_t position = (uint64_t) out.tellp();
+	if (position < end) {
+		out.write(zeros, end - position);
+	}
+}
+
+bool StockMarket::saveSnapshot(const char* path)
+{
+	// Trades waiting in the reorder buffers are saved at their place
+	flushTrades();
+	
+	// Layout: compute all offsets first
+	SnapshotHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+	header.version       = SNAPSHOT_VERSION;
+	header.numStocks     = (uint32_t) _stocks.size();
+	header.geometricMean = _geometricMean;
+	
+	const char* name     = _name     ? _name     : "";
+	const char* location = _location ? _location : "";
+	const char* country  = _country  ? _country  : "";
+	uint64_t offset = sizeof(SnapshotHeader);
+	header.nameOffset     = offset; offset += strlen(name)     + 1;
+	header.locationOffset = offset; offset += strlen(location) + 1;
+	header.countryOffset  = offset; offset += strlen(country)  + 1;
+	
+	vector<SnapshotStock> stocks(_stocks.size());
+	for (size_t id = 0; id < _stocks.size(); ++id) {
+		SymbolId       symbolId = (SymbolId) id;
+		SnapshotStock& record   = stocks[id];
+		memset(&record, 0, sizeof(record));
+		record.symbolOffset       = offset;
+		offset                   += _symbols.name(symbolId).size() + 1;
+		record.kind               = _table.kind(symbolId) == STOCK_PREFERRED ?
+									SNAPSHOT_PREFERRED_STOCK : SNAPSHOT_COMMON_STOCK;
+		record.lastDividend       = _table.lastDividend      (symbolId);
+		record.parValue           = _table.parValue          (symbolId);
+		record.fixedDividend      = _table.fixedDividend     (symbolId);
+		record.lastPrice          = _table.lastPrice         (symbolId);
+		record.lastDividendYield  = _table.lastDividendYield (symbolId);
+		record.lastPERatio        = _table.lastPERatio       (symbolId);
+		record.weightedStockPrice = _table.weightedStockPrice(symbolId);
+		record.numTrades          = _trades[id]->size();
+		header.numTrades         += record.numTrades;
+	}
+	offset = align8(offset);
+	header.stocksOffset = offset;
+	offset += stocks.size() * sizeof(SnapshotStock);
+	for (auto& record : stocks) {
+		record.timestampsOffset = offset; offset = align8(offset + record.numTrades * sizeof(int64_t));
+		record.pricesOffset     = offset; offset = align8(offset + record.numTrades * sizeof(int32_t));
+		record.quantitiesOffset = offset; offset = align8(offset + record.numTrades * sizeof(int32_t));
+		record.sidesOffset      = offset; offset = align8(offset + record.numTrades * sizeof(uint8_t));
+	}
+	header.fileSize = offset;
+	
+	// Write sections in file order
+	ofstream out(path, ios::binary | ios::trunc);
+	if (!out) {
+		cout << "Cannot write snapshot '" << path << "'" << endl;
+		return false;
+	}
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.write(name,     strlen(name)     + 1);
+	out.write(location, strlen(location) + 1);
+	out.write(country,  strlen(country)  + 1);
+	for (size_t id = 0; id < _stocks.size(); ++id) {
+		string const& symbol = _symbols.name((SymbolId) id);
+		uint64_t      end    = id + 1 < _stocks.size() ? stocks[id + 1].symbolOffset : header.stocksOffset;
+		writeAt(out, end, symbol.c_str(), symbol.size() + 1);
+	}
+	writeAt(out, header.stocksOffset, NULL, 0);
+	out.write(reinterpret_cast<const char*>(stocks.data()), stocks.size() * sizeof(SnapshotStock));
+	for (size_t id = 0; id < _stocks.size(); ++id) {
+		TradesView trades(_trades[id]);
+		size_t     numBlocks = trades.numBlocks();
+		for (size_t k = 0; k < numBlocks; ++k) {
+			out.write(reinterpret_cast<const char*>(trades.block(k).timestamps), trades.blockSize(k) * sizeof(int64_t));
+		}
+		writeAt(out, stocks[id].pricesOffset, NULL, 0);
+		for (size_t k = 0; k < numBlocks; ++k) {
+			out.write(reinterpret_cast<const char*>(trades.block(k).prices), trades.blockSize(k) * sizeof(int32_t));
+		}
+		writeAt(out, stocks[id].quantitiesOffset, NULL, 0);
+		for (size_t k = 0; k < numBlocks; ++k) {
+			out.write(reinterpret_cast<const char*>(trades.block(k).quantities), trades.blockSize(k) * sizeof(int32_t));
+		}
+		writeAt(out, stocks[id].sidesOffset, NULL, 0);
+		for (size_t k = 0; k < numBlocks; ++k) {
+			out.write(reinterpret_cast<const char*>(trades.block(k).sides), trades.blockSize(k));
+		}
+		uint64_t end = id + 1 < _stocks.size() ? stocks[id + 1].timestampsOffset : header.fileSize;
+		writeAt(out, end, NULL, 0);
+	}
+	out.close();
+	if (!out) {
+		cout << "Cannot write snapshot '" << path << "'" << endl;
+		return false;
+	}
+	return true;
+}
+
+//! Copy a NUL terminated string of the snapshot into the arena,
+//! NULL if the string is not inside the file
+static const char* copyString(Arena& arena, const char* base, uint64_t offset, uint64_t fileSize)
+{
+	if (offset >= fileSize) {
+		return NULL;
+	}
+	const char* string = base + offset;
+	size_t      length = strnlen(string, fileSize - offset);
+	if (length == fileSize - offset) {
+		return NULL;
+	}
+	char* result = arena.allocateArray<char>(length + 1);
+	memcpy(result, string, length + 1);
+	return result;
+}
+
+//! Check a column of 'count' elements of 'size' bytes lies inside the file
+static bool validColumn(uint64_t offset, uint64_t count, size_t size, uint64_t fileSize)
+{
+	return offset <= fileSize && count <= (fileSize - offset) / size;
+}
+
+bool StockMarket::loadSnapshot(const char* path)
+{
+	if (!_stocks.empty()) {
+		cout << "Cannot load snapshot '" << path << "' into a non empty stock market" << endl;
+		return false;
+	}
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		cout << "Cannot open snapshot '" << path << "'" << endl;
+		return false;
+	}
+	struct stat status;
+	void*       mapping = MAP_FAILED;
+	size_t      size    = 0;
+	if (fstat(fd, &status) == 0 && (size_t) status.st_size >= sizeof(SnapshotHeader)) {
+		size    = (size_t) status.st_size;
+		mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		cout << "Invalid snapshot '" << path << "'" << endl;
+		return false;
+	}
+	
+	const char*           base   = static_cast<const char*>(mapping);
+	SnapshotHeader const& header = *reinterpret_cast<const SnapshotHeader*>(base);
+	bool result = memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0 &&
+				  header.version  == SNAPSHOT_VERSION &&
+				  header.fileSize == size &&
+				  header.stocksOffset % 8 == 0 &&
+				  validColumn(header.stocksOffset, header.numStocks, sizeof(SnapshotStock), size);
+	
+	const char* name     = result ? copyString(_arena, base, header.nameOffset,     size) : NULL;
+	const char* location = result ? copyString(_arena, base, header.locationOffset, size) : NULL;
+	const char* country  = result ? copyString(_arena, base, header.countryOffset,  size) : NULL;
+	result = result && name && location && country;
+	
+	// Loading must not be journaled: trades do not go through 'addTrade'
+	TradeJournal* journal = _journal;
+	_journal = NULL;
+	const SnapshotStock* stocks = result ? reinterpret_cast<const SnapshotStock*>(base + header.stocksOffset) : NULL;
+	for (uint32_t i = 0; result && i < header.numStocks; ++i) {
+		SnapshotStock const& record = stocks[i];
+		const char*          symbol = copyString(_arena, base, record.symbolOffset, size);
+		result = symbol && 
+				 record.timestampsOffset % 8 == 0 &&
+				 record.pricesOffset     % 4 == 0 &&
+				 record.quantitiesOffset % 4 == 0 &&
+				 validColumn(record.timestampsOffset, record.numTrades, sizeof(int64_t), size) &&
+				 validColumn(record.pricesOffset,     record.numTrades, sizeof(int32_t), size) &&
+				 validColumn(record.quantitiesOffset, record.numTrades, sizeof(int32_t), size) &&
+				 validColumn(record.sidesOffset,      record.numTrades, sizeof(uint8_t), size);
+		if (result) {
+			if (record.kind == SNAPSHOT_PREFERRED_STOCK) {
+				PreferredStock stock(symbol, record.lastDividend, record.parValue, record.fixedDividend);
+				result = addStock(&stock);
+			} else {
+				Stock stock(symbol, record.lastDividend, record.parValue);
+				result = addStock(&stock);
+			}
+		}
+		if (result) {
+			SymbolId id = (SymbolId) (_stocks.size() - 1);
+			_table.lastPrice     (id, record.lastPrice);
+			_table.computedValues(id, record.lastDividendYield, record.lastPERatio, record.weightedStockPrice);
+			refreshStock(id);
+			
+			const time_t*        timestamps = reinterpret_cast<const time_t*>(base + record.timestampsOffset);
+			const int*           prices     = reinterpret_cast<const int*>(base + record.pricesOffset);
+			const int*           quantities = reinterpret_cast<const int*>(base + record.quantitiesOffset);
+			const unsigned char* sides      = reinterpret_cast<const unsigned char*>(base + record.sidesOffset);
+			size_t               numTrades  = (size_t) record.numTrades;
+			if (std::is_sorted(timestamps, timestamps + numTrades)) {
+				_trades[id]->append(prices, quantities, timestamps, sides, numTrades);
+			} else {
+				// Trades saved in arrival order
+				for (size_t j = 0; j < numTrades; ++j) {
+					_trades[id]->insert(prices[j], quantities[j], timestamps[j], sides[j] != 0);
+				}
+				_trades[id]->flush();
+			}
+			
+			for (size_t r = 0; r < _barResolutions.size(); ++r) {
+				rebuildBars(r, id);
+			}
+			
+			// Only the trades still inside the VWAP window are added to it
+			TradesView  trades(_trades[id]);
+			VwapWindow& window = _windows[id];
+			if (!trades.empty()) {
+				_clock.observe(trades.timestamp(trades.size() - 1));
+			}
+			window.advance(_clock.now());
+			for (size_t k = 0, numBlocks = trades.numBlocks(); k < numBlocks; ++k) {
+				TradeBlock const& block = trades.block(k);
+				for (size_t j = 0, n = trades.blockSize(k); j < n; ++j) {
+					window.addTrade(block.timestamps[j], block.prices[j], block.quantities[j]);
+				}
+			}
+		}
+	}
+	_journal = journal;
+	
+	if (result) {
+		// Trades already out of the retention are not kept
+		expireTrades();
+		_name          = name;
+		_location      = location;
+		_country       = country;
+		_geometricMean = header.geometricMean;
+	}
+	munmap(mapping, size);
+	if (!result) {
+		cout << "Invalid snapshot '" << path << "'" << endl;
+	}
+	return result;
+}
@@ -0,0 +1,58 @@
+#ifndef _MARKET_SNAPSHOT_H
+#define _MARKET_SNAPSHOT_H
+
+#include <stdint.h>
+
+// File declares the layout of the binary snapshot of a whole stock market
+// written by 'StockMarket::saveSnapshot'.
+//
+// [SnapshotHeader][strings][SnapshotStock x numStocks][trade columns]
+//
+// Strings are NUL terminated. The trade columns of each stock are stored
+// as contiguous arrays (timestamps, prices, quantities, sides) aligned on
+// 8 bytes, so loading a snapshot from a memory mapping only copies arrays.
+// All offsets are from the beginning of the file.
+
+const uint32_t SNAPSHOT_VERSION = 1;
+
+//! Kind of a stock in a snapshot
+enum SnapshotStockKind
+{
+	SNAPSHOT_COMMON_STOCK    = 1,
+	SNAPSHOT_PREFERRED_STOCK = 2
+};
+
+struct SnapshotHeader
+{
+	char     magic[8];
+	uint32_t version;
+	uint32_t numStocks;
+	uint64_t numTrades;
+	uint64_t fileSize;
+	double   geometricMean;
+	uint64_t nameOffset;
+	uint64_t locationOffset;
+	uint64_t countryOffset;
+	uint64_t stocksOffset;
+};
+
+struct SnapshotStock
+{
+	uint64_t symbolOffset;
+	uint32_t kind;
+	int32_t  lastDividend;
+	int32_t  parValue;
+	int32_t  fixedDividend;
+	int32_t  lastPrice;
+	int32_t  reserved;
+	double   lastDividendYield;
+	double   lastPERatio;
+	double   weightedStockPrice;
+	uint64_t numTrades;
+	uint64_t timestampsOffset;  // int64_t  x numTrades
+	uint64_t pricesOffset;      // int32_t  x numTrades
+	uint64_t quantitiesOffset;  // int32_t  x numTrades
+	uint64_t sidesOffset;       // uint8_t  x numTrades
+};
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef _MPSC_QUEUE_H
+#define _MPSC_QUEUE_H
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+//! Bounded lock-free multi-producer / single-consumer ring buffer.
+//! Each cell carries a sequence number telling whether it is ready to be
+//! written by a producer or read by the consumer, producers only compete
+//! on the enqueue position.
+//! Capacity is rounded up to a power of 2.
+template<typename T>
+class MpscQueue
+{
+	public:
+		MpscQueue(size_t capacity);
+		
+		//! Accessing
+		size_t capacity() const { return _mask + 1; }
+		
+		//! Approximate number of elements in the queue
+		size_t size() const {
+			size_t tail = _tail.load(std::memory_order_acquire);
+			size_t head = _head.load(std::memory_order_acquire);
+			return head > tail ? head - tail : 0;
+		}
+		
+		//! Add a value, returns false if the queue is full.
+		//! Safe to call from many threads at once
+		bool tryPush(T const& value);
+		
+		//! Remove a value, returns false if the queue is empty.
+		//! Must only be called by the consumer thread
+		bool tryPop(T& value);
+		
+		//! Remove up to 'max' values, returns the number of values removed.
+		//! Must only be called by the consumer thread
+		size_t popBatch(T* values, size_t max);
+		
+	private:
+		struct Cell {
+			std::atomic<size_t> sequence;
+			T                   value;
+		};
+		
+		// Positions padded to their own cache line, without over-aligning
+		// the queue so it can be allocated with 'new'
+		std::vector<Cell>   _cells;
+		size_t              _mask;
+		char                _headPadding[64];
+		std::atomic<size_t> _head;  // enqueue position
+		char                _tailPadding[64 - sizeof(std::atomic<size_t>)];
+		std::atomic<size_t> _tail;  // dequeue position
+		char                _endPadding [64 - sizeof(std::atomic<size_t>)];
+		
+	//! Disable copy constructor and 
+	//! copy assignment operator
+	MpscQueue(const MpscQueue&);
+	MpscQueue& operator=(const MpscQueue&);
+};
+
+template<typename T>
+MpscQueue<T>::MpscQueue(size_t capacity) :
+			_cells(),
+			_mask (0),
+			_head (0),
+			_tail (0)
+{
+	size_t size = 2;
+	while (size < capacity) {
+		size *= 2;
+	}
+	std::vector<Cell> cells(size);
+	_cells.swap(cells);
+	_mask = size - 1;
+	for (size_t i = 0; i < size; ++i) {
+		_cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+template<typename T>
+bool MpscQueue<T>::tryPush(T const& value)
+{
+	size_t position = _head.load(std::memory_order_relaxed);
+	for (;;) {
+		Cell&     cell     = _cells[position & _mask];
+		size_t    sequence = cell.sequence.load(std::memory_order_acquire);
+		ptrdiff_t diff     = (ptrdiff_t) sequence - (ptrdiff_t) position;
+		if (diff == 0) {
+			// Cell free: try to claim it
+			if (_head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+				cell.value = value;
+				cell.sequence.store(position + 1, std::memory_order_release);
+				return true;
+			}
+		} else if (diff < 0) {
+			// Cell not yet consumed: queue full
+			return false;
+		} else {
+			// Another producer claimed the cell
+			position = _head.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+template<typename T>
+bool MpscQueue<T>::tryPop(T& value)
+{
+	size_t position = _tail.load(std::memory_order_relaxed);
+	Cell&  cell     = _cells[position & _mask];
+	if (cell.sequence.load(std::memory_order_acquire) != position + 1) {
+		return false;
+	}
+	value = cell.value;
+	cell.sequence.store(position + _mask + 1, std::memory_order_release);
+	_tail.store(position + 1, std::memory_order_release);
+	return true;
+}
+
+template<typename T>
+size_t MpscQueue<T>::popBatch(T* values, size_t max)
+{
+	size_t position = _tail.load(std::memory_order_relaxed);
+	size_t count    = 0;
+	while (count < max) {
+		Cell& cell = _cells[(position + count) & _mask];
+		if (cell.sequence.load(std::memory_order_acquire) != position + count + 1) {
+			break;
+		}
+		values[count] = cell.value;
+		cell.sequence.store(position + count + _mask + 1, std::memory_order_release);
+		count++;
+	}
+	_tail.store(position + count, std::memory_order_release);
+	return count;
+}
+
+#endif
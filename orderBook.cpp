@@ -0,0 +1,248 @@
+#include "orderBook.h"
+#include "stockMarket.h"
+#include <algorithm>
+
+using namespace std;
+
+static const size_t INITIAL_PRICE_LEVELS = 1024;
+
+const size_t   OrderBook::MAX_PRICE_LEVELS;
+const uint32_t OrderBook::NO_ORDER;
+
+OrderBook::OrderBook(StockMarket& market, const char* symbol) :
+					_market    (market),
+					_id        (market.symbolId(symbol)),
+					_levels    (),
+					_lowPrice  (0),
+					_nodes     (),
+					_freeNodes (NO_ORDER),
+					_sequence  (0),
+					_numOrders (0),
+					_numBids   (0),
+					_numAsks   (0),
+					_bestBid   (0),
+					_bestAsk   (0),
+					_lowestBid (0),
+					_highestAsk(0)
+					{}
+
+int64_t OrderBook::quantityAt(int price) const
+{
+	if (_levels.empty() || price < _lowPrice || (size_t) (price - _lowPrice) >= _levels.size()) {
+		return 0;
+	}
+	return _levels[price - _lowPrice].quantity;
+}
+
+OrderStatus OrderBook::addOrder(bool buy, int price, int quantity, time_t timestamp)
+{
+	OrderStatus status = { INVALID_ORDER, 0, 0, 0 };
+	if (!valid() || price <= 0 || quantity <= 0 || !cover(price)) {
+		return status;
+	}
+	int remaining = match(buy, price, quantity, timestamp, status);
+	status.filled = quantity - remaining;
+	if (remaining > 0) {
+		status.id      = rest(buy, price, remaining);
+		status.resting = remaining;
+	}
+	return status;
+}
+
+int OrderBook::match(bool buy, int limit, int quantity, time_t timestamp, OrderStatus& status)
+{
+	size_t& numResting = buy ? _numAsks : _numBids;
+	while (quantity > 0 && numResting > 0) {
+		int best = buy ? _bestAsk : _bestBid;
+		if (buy ? best > limit : best < limit) {
+			break;
+		}
+		Level& resting = level(best);
+		while (quantity > 0 && resting.head != NO_ORDER) {
+			uint32_t   index    = resting.head;
+			OrderNode& node     = _nodes[index];
+			int        executed = min(quantity, node.quantity);
+			_market.addTrade(_id, best, executed, buy, timestamp);
+			status.numTrades++;
+			node.quantity    -= executed;
+			resting.quantity -= executed;
+			quantity         -= executed;
+			if (node.quantity == 0) {
+				unlink(index);
+				freeNode(index);
+				numResting--;
+				_numOrders--;
+			}
+		}
+		if (resting.head == NO_ORDER && numResting > 0) {
+			if (buy) {
+				nextAsk();
+			} else {
+				nextBid();
+			}
+		}
+	}
+	return quantity;
+}
+
+OrderId OrderBook::rest(bool buy, int price, int quantity)
+{
+	uint32_t   index = allocateNode();
+	OrderNode& node  = _nodes[index];
+	node.id       = (++_sequence << 32) | index;
+	node.price    = price;
+	node.quantity = quantity;
+	node.buy      = buy;
+	node.next     = NO_ORDER;
+
+	Level& resting = level(price);
+	node.previous = resting.tail;
+	if (resting.tail != NO_ORDER) {
+		_nodes[resting.tail].next = index;
+	} else {
+		resting.head = index;
+	}
+	resting.tail      = index;
+	resting.quantity += quantity;
+
+	if (buy) {
+		if (_numBids == 0 || price > _bestBid)   _bestBid   = price;
+		if (_numBids == 0 || price < _lowestBid) _lowestBid = price;
+		_numBids++;
+	} else {
+		if (_numAsks == 0 || price < _bestAsk)    _bestAsk    = price;
+		if (_numAsks == 0 || price > _highestAsk) _highestAsk = price;
+		_numAsks++;
+	}
+	_numOrders++;
+	return node.id;
+}
+
+bool OrderBook::cancel(OrderId id)
+{
+	uint32_t index = (uint32_t) id;
+	if (id == INVALID_ORDER || index >= _nodes.size() || _nodes[index].id != id) {
+		return false;
+	}
+	OrderNode& node    = _nodes[index];
+	Level&     resting = level(node.price);
+	bool       buy     = node.buy;
+	int        price   = node.price;
+	resting.quantity -= node.quantity;
+	unlink(index);
+	freeNode(index);
+	_numOrders--;
+	if (buy) {
+		_numBids--;
+		if (_numBids > 0 && resting.head == NO_ORDER && price == _bestBid) {
+			nextBid();
+		}
+	} else {
+		_numAsks--;
+		if (_numAsks > 0 && resting.head == NO_ORDER && price == _bestAsk) {
+			nextAsk();
+		}
+	}
+	return true;
+}
+
+void OrderBook::clear()
+{
+	Level empty = { NO_ORDER, NO_ORDER, 0 };
+	fill(_levels.begin(), _levels.end(), empty);
+	_freeNodes = NO_ORDER;
+	for (size_t i = _nodes.size(); i > 0; --i) {
+		freeNode((uint32_t) (i - 1));
+	}
+	_numOrders = 0;
+	_numBids   = 0;
+	_numAsks   = 0;
+}
+
+bool OrderBook::cover(int price)
+{
+	Level empty = { NO_ORDER, NO_ORDER, 0 };
+	if (_levels.empty()) {
+		_lowPrice = max(1, price - (int) INITIAL_PRICE_LEVELS / 2);
+		_levels.assign(INITIAL_PRICE_LEVELS, empty);
+	}
+	// Grown by doubling at least, the prices of a stock drift slowly
+	int64_t size = (int64_t) _levels.size();
+	if (price < _lowPrice) {
+		int64_t low = max<int64_t>(1, min<int64_t>(price, _lowPrice - size));
+		if (_lowPrice - low + size > (int64_t) MAX_PRICE_LEVELS) {
+			low = price;
+			if (_lowPrice - low + size > (int64_t) MAX_PRICE_LEVELS) {
+				return false;
+			}
+		}
+		_levels.insert(_levels.begin(), (size_t) (_lowPrice - low), empty);
+		_lowPrice = (int) low;
+	} else if (price - (int64_t) _lowPrice >= size) {
+		int64_t needed = price - (int64_t) _lowPrice + 1;
+		if (needed > (int64_t) MAX_PRICE_LEVELS) {
+			return false;
+		}
+		_levels.resize((size_t) min<int64_t>(max(needed, 2 * size), MAX_PRICE_LEVELS), empty);
+	}
+	return true;
+}
+
+uint32_t OrderBook::allocateNode()
+{
+	if (_freeNodes == NO_ORDER) {
+		OrderNode node = { INVALID_ORDER, 0, 0, NO_ORDER, NO_ORDER, false };
+		_nodes.push_back(node);
+		return (uint32_t) (_nodes.size() - 1);
+	}
+	uint32_t index = _freeNodes;
+	_freeNodes = _nodes[index].next;
+	return index;
+}
+
+void OrderBook::freeNode(uint32_t index)
+{
+	OrderNode& node = _nodes[index];
+	node.id       = INVALID_ORDER;
+	node.quantity = 0;
+	node.previous = NO_ORDER;
+	node.next     = _freeNodes;
+	_freeNodes    = index;
+}
+
+void OrderBook::unlink(uint32_t index)
+{
+	OrderNode& node    = _nodes[index];
+	Level&     resting = level(node.price);
+	if (node.previous != NO_ORDER) {
+		_nodes[node.previous].next = node.next;
+	} else {
+		resting.head = node.next;
+	}
+	if (node.next != NO_ORDER) {
+		_nodes[node.next].previous = node.previous;
+	} else {
+		resting.tail = node.previous;
+	}
+}
+
+void OrderBook::nextBid()
+{
+	// The book is never crossed: the levels below the best bid only hold bids
+	for (int price = _bestBid - 1; price >= _lowestBid; --price) {
+		if (level(price).quantity > 0) {
+			_bestBid = price;
+			return;
+		}
+	}
+}
+
+void OrderBook::nextAsk()
+{
+	for (int price = _bestAsk + 1; price <= _highestAsk; ++price) {
+		if (level(price).quantity > 0) {
+			_bestAsk = price;
+			return;
+		}
+	}
+}
@@ -0,0 +1,136 @@
+#ifndef _ORDER_BOOK_H
+#define _ORDER_BOOK_H
+
+#include <vector>
+#include <stdint.h>
+#include "time.h"
+#include "symbolTable.h"
+
+// File declares the limit order book of a stock. Orders are matched by
+// price then time priority, each execution is added to the stock market
+// as a trade of the stock, so simulated order flow and executed prints
+// feed the same stock values.
+
+class StockMarket;
+
+typedef uint64_t OrderId;
+
+//! Identifier never given to an order
+const OrderId INVALID_ORDER = 0;
+
+//! Outcome of an order
+struct OrderStatus
+{
+	OrderId id;         // of the order resting in the book, INVALID_ORDER if none
+	int     filled;     // quantity executed on arrival
+	int     resting;    // quantity left in the book
+	int     numTrades;  // trades added to the stock market
+};
+
+//! Limit order book of one stock of a stock market.
+//! Price levels are held in an array indexed by price, from the lowest
+//! to the highest price seen, so the best prices are found by scanning
+//! neighbouring levels. Each level holds its orders in time priority in
+//! an intrusive list of pooled order nodes: resting and cancelling an
+//! order allocate nothing once the pool and the levels are warm.
+//! Each execution is added to the stock market at the price of the
+//! resting order, flagged with the side of the incoming order.
+//! NOTE: the book must be used by the thread allowed to modify the
+//! stock market
+class OrderBook
+{
+	public:
+		//! Widest range of prices held by the book
+		static const size_t MAX_PRICE_LEVELS = 1 << 20;
+
+		//! Book of a stock registered to the stock market.
+		//! Orders are refused when the stock is not registered
+		OrderBook(StockMarket& market, const char* symbol);
+
+		//! Accessing
+		SymbolId symbolId () const { return _id;           }
+		bool     valid    () const { return _id != INVALID_SYMBOL; }
+		size_t   numOrders() const { return _numOrders;    }
+
+		//! Best prices, 0 when the side of the book is empty
+		int bestBid() const { return _numBids > 0 ? _bestBid : 0; }
+		int bestAsk() const { return _numAsks > 0 ? _bestAsk : 0; }
+
+		//! Quantity resting at a price, on either side
+		int64_t quantityAt(int price) const;
+
+		//! Match a limit order against the other side of the book and rest
+		//! the remaining quantity. The order is refused, with an empty
+		//! status, if the book is not valid, the price or the quantity is
+		//! not positive, or the price is too far from the prices of the book
+		OrderStatus addOrder(bool buy, int price, int quantity, time_t timestamp);
+
+		//! Remove a resting order. Returns false if the order is unknown,
+		//! executed or already cancelled
+		bool cancel(OrderId id);
+
+		//! Remove all resting orders
+		void clear();
+
+	private:
+		static const uint32_t NO_ORDER = (uint32_t) -1;
+
+		//! Pooled order, linked in its price level or in the free list
+		struct OrderNode {
+			OrderId  id;
+			int      price;
+			int      quantity;
+			uint32_t previous;
+			uint32_t next;
+			bool     buy;
+		};
+
+		//! Orders resting at a price, in time priority
+		struct Level {
+			uint32_t head;
+			uint32_t tail;
+			int64_t  quantity;
+		};
+
+		//! Execute an incoming order against the resting orders
+		//! up to 'limit', returns the quantity left
+		int match(bool buy, int limit, int quantity, time_t timestamp, OrderStatus& status);
+
+		//! Rest an order, returns its identifier
+		OrderId rest(bool buy, int price, int quantity);
+
+		//! Make the levels cover 'price', returns false if too wide
+		bool cover(int price);
+
+		Level& level(int price) { return _levels[price - _lowPrice]; }
+
+		uint32_t allocateNode();
+		void     freeNode(uint32_t index);
+		void     unlink(uint32_t index);
+
+		//! Move the best price of a side to the next level holding orders
+		void nextBid();
+		void nextAsk();
+
+		StockMarket&           _market;
+		SymbolId               _id;
+		std::vector<Level>     _levels;      // indexed by price - '_lowPrice'
+		int                    _lowPrice;
+		std::vector<OrderNode> _nodes;
+		uint32_t               _freeNodes;   // free list of '_nodes'
+		uint64_t               _sequence;    // of the last order, high part of the identifiers
+		size_t                 _numOrders;
+		size_t                 _numBids;
+		size_t                 _numAsks;
+		int                    _bestBid;     // valid when the side holds orders
+		int                    _bestAsk;
+		int                    _lowestBid;   // bounds of the prices scanned for the next best price
+		int                    _highestAsk;
+
+	//! Disable copy constructor and
+	//! copy assignment operator
+	OrderBook(const OrderBook&);
+	OrderBook& operator=(const OrderBook&);
+};
+
+#endif
@@ -0,0 +1,56 @@
+#include "readSnapshot.h"
+#include "stockMarket.h"
+
+using namespace std;
+
+StockVersion::StockVersion(Stock* stock, TradeColumns& columns) :
+				_stock  (stock),
+				_headers(),
+				_trades (columns.freeze(_headers))
+				{}
+
+StockVersion::~StockVersion()
+{
+	delete _stock;
+}
+
+TradesView StockVersion::trades() const
+{
+	return _trades.size() > 0 ? TradesView(&_trades) : TradesView();
+}
+
+ReadSnapshot::ReadSnapshot(StockMarket const& market) :
+				_epochs (market._epochs),
+				_slot   (market._epochs.enter()),
+				_version(market._version.load())
+				{}
+
+ReadSnapshot::~ReadSnapshot()
+{
+	_epochs.exit(_slot);
+}
+
+SymbolId ReadSnapshot::symbolId(const char* symbol) const
+{
+	return _version && symbol ? _version->symbols->find(symbol) : INVALID_SYMBOL;
+}
+
+const Stock* ReadSnapshot::findStock(const char* symbol) const
+{
+	return findStock(symbolId(symbol));
+}
+
+const Stock* ReadSnapshot::findStock(SymbolId id) const
+{
+	return id < numStocks() ? &_version->stocks[id]->stock() : NULL;
+}
+
+TradesView ReadSnapshot::getTrades(const char* symbol) const
+{
+	return getTrades(symbolId(symbol));
+}
+
+TradesView ReadSnapshot::getTrades(SymbolId id) const
+{
+	return id < numStocks() ? _version->stocks[id]->trades() : TradesView();
+}
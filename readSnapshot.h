@@ -0,0 +1,97 @@
+#ifndef _READ_SNAPSHOT_H
+#define _READ_SNAPSHOT_H
+
+#include <vector>
+#include <stdint.h>
+#include "tradeStore.h"
+#include "symbolTable.h"
+#include "epochManager.h"
+
+// File declares the immutable versions of a stock market published by the
+// thread adding its trades ('StockMarket::publish'), and the snapshots other
+// threads read them through, without locks and without stalling the writer.
+// Versions replaced by a newer one are freed once the snapshots which may
+// read them are gone, see epochManager.h.
+
+class StockMarket;
+
+//! Values and trades of a stock when it was published, never modified
+class StockVersion
+{
+	public:
+		//! Takes ownership of 'stock', shares the trades of 'columns'
+		StockVersion(Stock* stock, TradeColumns& columns);
+		~StockVersion();
+
+		//! Accessing
+		const Stock& stock () const { return *_stock; }
+		TradesView   trades() const;
+
+	private:
+		Stock*                  _stock;
+		std::vector<TradeBlock> _headers;   // copies of the block headers of the trades
+		TradeColumns            _trades;
+
+	//! Disable copy constructor and
+	//! copy assignment operator
+	StockVersion(const StockVersion&);
+	StockVersion& operator=(const StockVersion&);
+};
+
+//! Version of a whole stock market, never modified.
+//! Stocks unchanged between two versions share their stock version
+struct MarketVersion
+{
+	uint64_t                         number;          // 1 for the first version published
+	double                           geometricMean;
+	int                              numTradedStocks;
+	const SymbolTable*               symbols;
+	std::vector<const StockVersion*> stocks;          // indexed by symbol identifier
+};
+
+//! Consistent read only view of the last version published by a stock market.
+//! The values and trades reached through a snapshot do not change and stay
+//! valid until the snapshot is destroyed, while the writer goes on adding
+//! trades and publishing. Taking and reading a snapshot is lock free and
+//! may be done from any thread.
+//! Snapshots should be short lived: the versions replaced meanwhile are only
+//! freed once the snapshot is gone.
+class ReadSnapshot
+{
+	public:
+		ReadSnapshot(StockMarket const& market);
+		~ReadSnapshot();
+
+		//! Accessing, the snapshot is not valid until the market published
+		bool     valid          () const { return _version != NULL; }
+		uint64_t version        () const { return _version ? _version->number          : 0;   }
+		double   geometricMean  () const { return _version ? _version->geometricMean   : 0.0; }
+		int      numTradedStocks() const { return _version ? _version->numTradedStocks : 0;   }
+		size_t   numStocks      () const { return _version ? _version->stocks.size()   : 0;   }
+
+		//! Return the identifier of a published stock symbol
+		//! or INVALID_SYMBOL if the stock is not published
+		SymbolId symbolId(const char* symbol) const;
+
+		//! Given a stock symbol, retrieve all (including computed) stock values
+		//! as published, or NULL if the stock is not published
+		const Stock* findStock(const char* symbol) const;
+		const Stock* findStock(SymbolId    id)     const;
+
+		//! Return a view over the published trades of a given symbol, sorted
+		//! by timestamp. The view is not valid if the symbol has not been traded
+		TradesView getTrades(const char* symbol) const;
+		TradesView getTrades(SymbolId    id)     const;
+
+	private:
+		EpochManager&        _epochs;
+		size_t               _slot;
+		const MarketVersion* _version;
+
+	//! Disable copy constructor and
+	//! copy assignment operator
+	ReadSnapshot(const ReadSnapshot&);
+	ReadSnapshot& operator=(const ReadSnapshot&);
+};
+
+#endif
@@ -0,0 +1,140 @@
+#include "shardedStockMarket.h"
+#include <cstring>
+#include <cmath>
+
+using namespace std;
+
+ShardedStockMarket::Shard::Shard(const char* name,
+								 const char* location,
+								 const char* country) :
+								lock  (),
+								market(name, location, country)
+								{}
+
+ShardedStockMarket::ShardedStockMarket(const char* name,
+									   const char* location,
+									   const char* country,
+									   size_t      numShards) :
+									_name             (name),
+									_location         (location),
+									_country          (country),
+									_shards           (),
+									_geometricMeanLock(),
+									_geometricMean    (0.0)
+{
+	if (numShards == 0) {
+		numShards = 1;
+	}
+	for (size_t i = 0; i < numShards; ++i) {
+		_shards.push_back(new Shard(name, location, country));
+	}
+}
+
+ShardedStockMarket::~ShardedStockMarket()
+{
+	for (auto shard : _shards) {
+		delete shard;
+	}
+	_shards.clear();
+}
+
+size_t ShardedStockMarket::shardOf(const char* symbol) const
+{
+	return symbol ? SymbolTable::hash(symbol, strlen(symbol)) % _shards.size() : 0;
+}
+
+bool ShardedStockMarket::addStock(const Stock* stock)
+{
+	bool result = false;
+	if (stock) {
+		Shard&           shard = *_shards[shardOf(stock->symbol().c_str())];
+		lock_guard<mutex> guard(shard.lock);
+		result = shard.market.addStock(stock);
+	}
+	return result;
+}
+
+SymbolId ShardedStockMarket::symbolId(const char* symbol) const
+{
+	size_t            index = shardOf(symbol);
+	const Shard&      shard = *_shards[index];
+	lock_guard<mutex> guard(shard.lock);
+	SymbolId id = shard.market.symbolId(symbol);
+	return id == INVALID_SYMBOL ? INVALID_SYMBOL : globalId(id, index);
+}
+
+bool ShardedStockMarket::addTrade(const Trade* trade)
+{
+	Shard& shard = *_shards[trade ? shardOf(trade->symbol().c_str()) : 0];
+	lock_guard<mutex> guard(shard.lock);
+	return shard.market.addTrade(trade);
+}
+
+bool ShardedStockMarket::addTrade(SymbolId id,
+								  int      price,
+								  int      quantity,
+								  bool     buy,
+								  time_t   timestamp)
+{
+	bool result = false;
+	if (id != INVALID_SYMBOL) {
+		Shard& shard = *_shards[shardOf(id)];
+		lock_guard<mutex> guard(shard.lock);
+		result = shard.market.addTrade(localId(id), price, quantity, buy, timestamp);
+	}
+	return result;
+}
+
+void ShardedStockMarket::computeStockValues()
+{
+	// Geometric Mean of all shards from the sum of the logarithms
+	// of the 'Volume Weighted Stock Price' of each one
+	double logSum    = 0.0;
+	int    numTraded = 0;
+	for (auto shard : _shards) {
+		lock_guard<mutex> guard(shard->lock);
+		shard->market.computeStockValues();
+		logSum    += shard->market.vwapLogSum();
+		numTraded += shard->market.numTradedStocks();
+	}
+	if (numTraded > 0) {
+		lock_guard<mutex> guard(_geometricMeanLock);
+		_geometricMean = exp(logSum / numTraded);
+	}
+}
+
+double ShardedStockMarket::geometricMean() const
+{
+	lock_guard<mutex> guard(_geometricMeanLock);
+	return _geometricMean;
+}
+
+Stock* ShardedStockMarket::findStock(const char* symbol) const
+{
+	Stock*            result = NULL;
+	const Shard&      shard  = *_shards[shardOf(symbol)];
+	lock_guard<mutex> guard(shard.lock);
+	const Stock* stock = shard.market.findStock(symbol);
+	if (stock) {
+		result = stock->clone();
+	}
+	return result;
+}
+
+MetricsSnapshot ShardedStockMarket::metrics() const
+{
+	// Metrics are read without the shard locks
+	MetricsSnapshot result;
+	for (auto shard : _shards) {
+		result.merge(shard->market.metrics());
+	}
+	return result;
+}
+
+void ShardedStockMarket::printInfo() const
+{
+	for (auto shard : _shards) {
+		lock_guard<mutex> guard(shard->lock);
+		shard->market.printInfo();
+	}
+}
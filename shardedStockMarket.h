@@ -0,0 +1,107 @@
+#ifndef _SHARDED_STOCK_MARKET_H
+#define _SHARDED_STOCK_MARKET_H
+
+#include <mutex>
+#include <vector>
+#include "stockMarket.h"
+
+//! Thread safe stock market for multi-core trade ingestion.
+//! Stock symbols are spread over N partitions (shards), each one being a
+//! 'StockMarket' protected by its own lock: trades of symbols living in
+//! different shards are added in parallel without contention.
+//!
+//! Symbol identifiers returned by 'symbolId' encode the shard of the symbol,
+//! they are not the identifiers of the underlying 'StockMarket' shards.
+class ShardedStockMarket
+{
+	public:
+		ShardedStockMarket(const char* name,
+						   const char* location,
+						   const char* country,
+						   size_t      numShards);
+		~ShardedStockMarket();
+		
+		//! Accessing
+		const char* getName()        const { return _name;          }
+		const char* getLocation()    const { return _location;      }
+		const char* getCountry()     const { return _country;       }
+		size_t      numShards()      const { return _shards.size(); }
+		double      geometricMean()  const;
+		
+		//! Add a stock to the shard of its symbol
+		//! Returns True if successfully added, otherwise false
+		bool addStock(const Stock* stock);
+		
+		//! Return the identifier of a registered stock symbol
+		//! or INVALID_SYMBOL if the stock is not registered
+		SymbolId symbolId(const char* symbol) const;
+		
+		//! Add a trade to the shard of its symbol, see 'StockMarket::addTrade'
+		//! Safe to call from many threads at once
+		bool addTrade(const Trade* trade);
+		bool addTrade(SymbolId id,
+					  int      price,
+					  int      quantity,
+					  bool     buy,
+					  time_t   timestamp);
+		
+		//! Compute the values of all stocks, shard by shard, and the
+		//! Geometric Mean of the whole market
+		void computeStockValues();
+		
+		//! Return a copy of the stock values of a given symbol, or NULL if
+		//! the stock is not registered. The caller owns the returned stock
+		Stock* findStock(const char* symbol) const;
+		
+		//! Call 'visitor(TradesView const&)' on the trades of a given symbol while
+		//! holding the lock of its shard. The view must not be kept after the call.
+		//! Returns false if the stock is not registered
+		template<typename Visitor>
+		bool getTrades(const char* symbol, Visitor visitor) const {
+			const Shard&                shard = *_shards[shardOf(symbol)];
+			std::lock_guard<std::mutex> guard(shard.lock);
+			SymbolId id = shard.market.symbolId(symbol);
+			if (id == INVALID_SYMBOL) {
+				return false;
+			}
+			visitor(shard.market.getTrades(id));
+			return true;
+		}
+		
+		//! Metrics of all shards summed, see 'StockMarket::metrics'
+		MetricsSnapshot metrics() const;
+		
+		//! Print the infos of all shards
+		void printInfo() const;
+		
+	private:
+		struct Shard {
+			Shard(const char* name, const char* location, const char* country);
+			
+			mutable std::mutex lock;
+			StockMarket        market;
+		};
+		
+		size_t shardOf(const char* symbol) const;
+		
+		//! Global identifier of a symbol from its shard identifier and back
+		SymbolId globalId(SymbolId localId, size_t shard) const {
+			return (SymbolId) (localId * _shards.size() + shard);
+		}
+		size_t   shardOf(SymbolId id) const { return id % _shards.size(); }
+		SymbolId localId(SymbolId id) const { return (SymbolId) (id / _shards.size()); }
+		
+		const char*          _name;
+		const char*          _location;
+		const char*          _country;
+		std::vector<Shard*>  _shards;
+		mutable std::mutex   _geometricMeanLock;
+		double               _geometricMean;
+		
+	//! Disable copy constructor and 
+	//! copy assignment operator
+	ShardedStockMarket(const ShardedStockMarket&);
+	ShardedStockMarket& operator=(const ShardedStockMarket&);
+};
+
+#endif
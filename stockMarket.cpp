@@ -1,63 +1,138 @@
 #include "stockMarket.h"
+#include "diagnostics.h"
 #include <iostream>
 #include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <limits>
 
 using namespace std;
 
 StockMarket::StockMarket():
-				_name         (NULL),
-				_location     (NULL),
-				_country      (NULL),
-				_geometricMean(0.0),
-				_stocks       (),
-				_trades       ()
+				_name           (NULL),
+				_location       (NULL),
+				_country        (NULL),
+				_geometricMean  (0.0),
+				_numTradedStocks(0),
+				_vwapLogSum     (0.0),
+				_vwapLogSumFixed(0),
+				_numNullVwaps   (0),
+				_arena          (),
+				_blockPool      (&_arena, &_epochs),
+				_epochs         (),
+				_symbols        (),
+				_table          (),
+				_stocks         (),
+				_trades         (),
+				_windows        (),
+				_states         (),
+				_barResolutions (),
+				_bars           (),
+				_dirtyStocks    (),
+				_windowChanges  (),
+				_journal        (NULL),
+				_clock          (),
+				_retention      (),
+				_numExpiredTrades(0),
+				_version        (NULL),
+				_stockVersions  (),
+				_publishedSymbols(NULL),
+				_unpublished    (),
+				_numVersions    (0),
+				_dispatcher     (NULL)
 				{}
 	
 StockMarket::StockMarket(const char* name,
 						const char* location,
 						const char* country):
-						_name         (name),
-						_location     (location),
-						_country      (country),
-						_geometricMean(0.0),
-						_stocks       (),
-						_trades       ()
+						_name           (name),
+						_location       (location),
+						_country        (country),
+						_geometricMean  (0.0),
+						_numTradedStocks(0),
+						_vwapLogSum     (0.0),
+						_vwapLogSumFixed(0),
+						_numNullVwaps   (0),
+						_arena          (),
+						_blockPool      (&_arena, &_epochs),
+						_epochs         (),
+						_symbols        (),
+						_table          (),
+						_stocks         (),
+						_trades         (),
+						_windows        (),
+						_states         (),
+						_barResolutions (),
+						_bars           (),
+						_dirtyStocks    (),
+						_windowChanges  (),
+						_journal        (NULL),
+						_clock          (),
+						_retention      (),
+						_numExpiredTrades(0),
+						_version        (NULL),
+						_stockVersions  (),
+						_publishedSymbols(NULL),
+						_unpublished    (),
+						_numVersions    (0),
+						_dispatcher     (NULL)
 						{}
 
 StockMarket::~StockMarket()						
 {
-	// Cleanup stocks memory
-	for (auto stock : _stocks) {
-		delete stock.second;
+	// Deliver the last changes before the market goes away
+	delete _dispatcher;
+	
+	// No reader may be left: free the last version
+	for (auto version : _stockVersions) {
+		delete version;
 	}
+	delete _version.load();
+	delete _publishedSymbols;
 	
-	// Cleanup trades memory
-	for (auto iter : _trades) {
-		TradesVec stockTrades = iter.second;
-		for (auto trade : stockTrades) { 
-			delete trade;
-		}
+	// Stocks and trades columns memory belongs to the arena,
+	// only run their destructors: the arena frees all slabs at once
+	for (auto stock : _stocks) {
+		stock->~Stock();
+	}
+	for (auto columns : _trades) {
+		columns->~TradeColumns();
 	}
+	
 	_stocks.clear();
 	_trades.clear();
+	_windows.clear();
 }
 
 bool StockMarket::addStock(const Stock* stock)
 {
 	bool result = false;
 	if (stock) {
-		string symbol = stock->symbol();
-		if (!symbol.empty() && 
-			_stocks.find(symbol) == _stocks.end()) {
+		string const& symbol = stock->symbol();
+		if (!symbol.empty() && _symbols.find(symbol.c_str(), symbol.size()) == INVALID_SYMBOL) {
 			// Take ownership of stock memory
-			Stock* newStock = stock->clone();
+			Stock* newStock = stock->clone(_arena);
 			if (newStock) {
-				_stocks[symbol] = newStock;
+				// Identifiers are dense: the new symbol identifier
+				// is the index of the values added below
+				_symbols.intern(symbol.c_str());
+				_table  .add(newStock);
+				_stocks .push_back(newStock);
+				_trades .push_back(_arena.create<TradeColumns>(symbol, &_blockPool));
+				_windows.push_back(VwapWindow());
+				StockState state = { 0, CONTRIBUTION_NONE, false, false, VwapWindow::NO_CHANGE };
+				_states .push_back(state);
+				for (size_t r = 0; r < _barResolutions.size(); ++r) {
+					_bars[r].push_back(BarSeries(_barResolutions[r]));
+				}
+				markDirty((SymbolId) (_stocks.size() - 1));
+				if (_journal) {
+					_journal->appendStock(newStock);
+				}
 				result = true;
 			}
 		} else {
-			cout << "Stock '" << stock->symbol() << "' not added to stock markert '"
-				<< _name << "'" << endl;
+			diagnostics().report(DIAG_STOCK_NOT_ADDED, stock->symbol().c_str(), _name);
 		}
 	}
 	return result;
@@ -69,87 +144,539 @@ bool StockMarket::addTrade(const Trade* trade)
 	if (trade) {
 		// Make sure stock symbol is already registered
 		// Otherwise cannot trade with unregistered stock
-		string symbol = trade->symbol();
+		string const& symbol = trade->symbol();
 		if (!symbol.empty()) {
-			 StocksMap::iterator iter = _stocks.find(symbol);
-			if (iter != _stocks.end()) {
-				// Take ownership of trade memory
-				Trade* newTrade = new Trade(*trade);
-				if (newTrade) {
-					TradesMapIter it = _trades.find(symbol);
-					if (it == _trades.end()) {
-						// Stock is registered but not yet traded
-						TradesVec stockTrades;
-						stockTrades.push_back(newTrade);
-						_trades[symbol] = stockTrades;
-					} else {
-						// Stock has been previously traded
-						(*it).second.push_back(newTrade);
-					}
-					// Eventually update the stock price
-					Stock *stock = (*iter).second;
-					stock->lastPrice(newTrade->price());
-					result = true;
-				}  // newTrade
-			} // stocks iter
+			SymbolId id = _symbols.find(symbol.c_str(), symbol.size());
+			if (id != INVALID_SYMBOL) {
+				result = addTrade(id, 
+								  trade->price(),
+								  trade->quantity(),
+								  trade->buying(),
+								  trade->timestamp());
+			} else {
+				METRICS_COUNT(_metrics, COUNTER_TRADES_REJECTED, 1);
+			}
 		} else {
-			cout << "Cannot add trade '" << symbol 
-			    << "' (invalid symbol or unregistered stock)" << endl;
+			METRICS_COUNT(_metrics, COUNTER_TRADES_REJECTED, 1);
+			diagnostics().report(DIAG_TRADE_INVALID_SYMBOL, symbol.c_str());
 		}
 	} else {
-		cout << "Invalid trade pointer " << endl;
+		METRICS_COUNT(_metrics, COUNTER_TRADES_REJECTED, 1);
+		diagnostics().report(DIAG_TRADE_INVALID_POINTER, NULL);
 	}
 	return result;
 }
 
-void StockMarket::computeStockValues()
+bool StockMarket::addTrade(SymbolId id,
+						   int      price,
+						   int      quantity,
+						   bool     buy,
+						   time_t   timestamp)
 {
-	double geometricMeanAcc = 1.0;  // accumulate values used to compute Geometric Mean
-	int    numTrades        = 0;    // Only traded stocks will be used to compute the Geometric Mean
-	for (auto iter : _stocks) {
-		Stock* stock = iter.second;
-		string symbol = stock->symbol();
-		int    price  = stock->lastPrice();
-				 
-		double dividendYied = stock->computeDividendYield(price); 
-		double PERatio      = stock->computePERatio(price); 
-			
-		TradesMapIter it = _trades.find(symbol);
-		if (it != _trades.end()) {
-			numTrades++;
-			double vwapValue = stock->computeWeightedStockPrice((*it).second);
-			geometricMeanAcc *= vwapValue;
+	METRICS_TIME_SCOPE(_metrics, LATENCY_ADD_TRADE);
+	bool result = false;
+	if (id < _stocks.size()) {
+		// Store the trade values in the columns of this stock, in time order
+		_trades[id]->insert(price, quantity, timestamp, buy);
+		_clock.observe(timestamp);
+		// Keep the rolling VWAP window up to date
+		_windows[id].addTrade(timestamp, price, quantity);
+		for (size_t r = 0; r < _bars.size(); ++r) {
+			_bars[r][id].addTrade(timestamp, price, quantity);
+		}
+		// Eventually update the stock price
+		_table.lastPrice(id, price);
+		_stocks[id]->lastPrice(price);
+		markDirty(id);
+		if (_journal) {
+			_journal->appendTrade(_symbols.name(id).c_str(), price, quantity, buy, timestamp);
+		}
+		if (_retention.enabled()) {
+			expireTrades(id);
+		}
+		result = true;
+		METRICS_COUNT(_metrics, COUNTER_TRADES_ACCEPTED, 1);
+	} else {
+		METRICS_COUNT(_metrics, COUNTER_TRADES_REJECTED, 1);
+	}
+	return result;
+}
+
+size_t StockMarket::addTrades(TradeSpan trades)
+{
+	size_t             result   = 0;
+	SymbolId           id       = INVALID_SYMBOL;
+	const TradeRecord* previous = NULL;
+	for (const TradeRecord* record = trades.begin(); record != trades.end(); ++record) {
+		if (record->id != INVALID_SYMBOL) {
+			id = record->id;
+		} else if (!previous || previous->id != INVALID_SYMBOL ||
+				   strcmp(previous->symbol, record->symbol) != 0) {
+			// New run of trades: look the symbol up
+			id = _symbols.find(record->symbol);
+		}
+		previous = record;
+		if (addTrade(id, record->price, record->quantity, record->buy, record->timestamp)) {
+			result++;
+		}
+	}
+	return result;
+}
+
+bool StockMarket::addBarResolution(time_t seconds)
+{
+	bool result = false;
+	if (seconds > 0 &&
+		std::find(_barResolutions.begin(), _barResolutions.end(), seconds) == _barResolutions.end()) {
+		_barResolutions.push_back(seconds);
+		_bars.push_back(BarSeriesVec(_stocks.size(), BarSeries(seconds)));
+		for (size_t id = 0; id < _stocks.size(); ++id) {
+			rebuildBars(_bars.size() - 1, (SymbolId) id);
+		}
+		result = true;
+	}
+	return result;
+}
+
+void StockMarket::rebuildBars(size_t resolution, SymbolId id)
+{
+	BarSeries& series = _bars[resolution][id];
+	series = BarSeries(_barResolutions[resolution]);
+	_trades[id]->flush();
+	TradesView trades(_trades[id]);
+	for (size_t k = 0, numBlocks = trades.numBlocks(); k < numBlocks; ++k) {
+		TradeBlock const& block = trades.block(k);
+		for (size_t j = 0, n = trades.blockSize(k); j < n; ++j) {
+			series.addTrade(block.timestamps[j], block.prices[j], block.quantities[j]);
+		}
+	}
+}
+
+void StockMarket::setRetention(RetentionPolicy const& policy)
+{
+	_retention = policy;
+	expireTrades();
+}
+
+size_t StockMarket::expireTrades()
+{
+	size_t result = 0;
+	if (_retention.enabled()) {
+		for (size_t id = 0; id < _trades.size(); ++id) {
+			result += expireTrades((SymbolId) id);
+		}
+		if (_retention.maxBytes > 0 && retainedBytes() > _retention.maxBytes) {
+			result += expireBytes();
+		}
+	}
+	return result;
+}
+
+size_t StockMarket::expireTrades(SymbolId id)
+{
+	// Oldest blocks of the stock expiring by age or by count
+	TradeColumns* columns = _trades[id];
+	if (columns->numBlocks() == 0) {
+		return 0;
+	}
+	size_t        count   = 0;
+	size_t        kept    = columns->size();
+	time_t        horizon = _clock.eventTime() - _retention.maxAge;
+	while (count + 1 < columns->numBlocks()) {
+		TradeBlock const& block = columns->block(count);
+		if (!(_retention.maxAge > 0 && block.timestamps[block.count - 1] < horizon) &&
+			!(_retention.maxTradesPerStock > 0 && kept - block.count >= _retention.maxTradesPerStock)) {
+			break;
+		}
+		kept -= block.count;
+		count++;
+	}
+	size_t result = count > 0 ? expireBlocks(id, count) : 0;
+	// The market only grows when a stock starts a new block
+	TradeBlock const& last = columns->block(columns->numBlocks() - 1);
+	if (_retention.maxBytes > 0 && last.count == 1 && retainedBytes() > _retention.maxBytes) {
+		result += expireBytes();
+	}
+	return result;
+}
+
+size_t StockMarket::expireBlocks(SymbolId id, size_t count)
+{
+	TradeColumns* columns = _trades[id];
+	if (_retention.archive) {
+		const char* symbol = _symbols.name(id).c_str();
+		for (size_t k = 0; k < count && k + 1 < columns->numBlocks(); ++k) {
+			TradeBlock const& block = columns->block(k);
+			for (size_t j = 0; j < block.count; ++j) {
+				_retention.archive->appendTrade(symbol, block.prices[j], block.quantities[j],
+												block.sides[j] != 0, block.timestamps[j]);
+			}
+		}
+	}
+	size_t result = columns->expire(count);
+	markUnpublished(id);
+	if (columns->numBlocks() > 0 && columns->block(0).count > 0) {
+		time_t oldest = columns->block(0).timestamps[0];
+		for (size_t r = 0; r < _bars.size(); ++r) {
+			_bars[r][id].expire(oldest);
+		}
+	}
+	_numExpiredTrades += result;
+	METRICS_COUNT(_metrics, COUNTER_TRADES_EXPIRED, result);
+	return result;
+}
+
+size_t StockMarket::expireBytes()
+{
+	// Expire the oldest blocks of the market down to 7/8 of the budget,
+	// so the next expiry by size waits for as many new blocks
+	typedef pair<time_t, SymbolId> Candidate;
+	priority_queue<Candidate, vector<Candidate>, greater<Candidate> > oldest;
+	for (size_t id = 0; id < _trades.size(); ++id) {
+		TradeColumns const* columns = _trades[id];
+		if (columns->numBlocks() > 1) {
+			TradeBlock const& block = columns->block(0);
+			oldest.push(Candidate(block.timestamps[block.count - 1], (SymbolId) id));
+		}
+	}
+	size_t target = _retention.maxBytes - _retention.maxBytes / 8;
+	size_t result = 0;
+	while (!oldest.empty() && retainedBytes() > target) {
+		SymbolId id = oldest.top().second;
+		oldest.pop();
+		result += expireBlocks(id, 1);
+		TradeColumns const* columns = _trades[id];
+		if (columns->numBlocks() > 1) {
+			TradeBlock const& block = columns->block(0);
+			oldest.push(Candidate(block.timestamps[block.count - 1], id));
+		}
+	}
+	return result;
+}
+
+void StockMarket::markDirty(SymbolId id)
+{
+	if (!_states[id].dirty) {
+		_states[id].dirty = true;
+		_dirtyStocks.push_back(id);
+	}
+	markUnpublished(id);
+}
+
+void StockMarket::markUnpublished(SymbolId id)
+{
+	if (!_states[id].unpublished) {
+		_states[id].unpublished = true;
+		_unpublished.push_back(id);
+	}
+}
+
+void StockMarket::collectWindowChanges(time_t now)
+{
+	while (!_windowChanges.empty() && _windowChanges.top().first <= now) {
+		WindowChange change = _windowChanges.top();
+		_windowChanges.pop();
+		// Skip changes planned before the stock was last recomputed
+		if (_states[change.second].nextChange == change.first) {
+			markDirty(change.second);
+		}
+	}
+}
+
+void StockMarket::computeStock(SymbolId id, time_t now, StockUpdate& update)
+{
+	// Dividend yield and P/E ratio were computed in the table by 'computeStocks'
+	const char* symbol = _symbols.name(id).c_str();
+	if (!_table.dividendYieldValid(id)) {
+		diagnostics().report(DIAG_DIVIDEND_YIELD_NOT_COMPUTED, symbol, NULL,
+							 _table.lastPrice(id), _table.lastDividend(id), id);
+	}
+	if (!_table.peRatioValid(id)) {
+		diagnostics().report(DIAG_PE_RATIO_NOT_COMPUTED, symbol, NULL,
+							 _table.lastPrice(id), _table.lastDividend(id), id);
+	}
+	METRICS_COUNT(_metrics, COUNTER_STOCKS_EVALUATED, 1);
+		
+	update.vwapLog      = 0;
+	update.contribution = CONTRIBUTION_NONE;
+	update.nextChange   = VwapWindow::NO_CHANGE;
+	if (!_trades[id]->empty()) {
+		long   sumPriceQuantity = 0;
+		long   sumQuantity      = 0;
+		double vwapValue        = 0.0;
+		_windows[id].sums(now, sumPriceQuantity, sumQuantity);
+		if (sumQuantity > 0) {
+			vwapValue = (double) sumPriceQuantity / sumQuantity;
+		} else {
+			diagnostics().report(DIAG_VWAP_NOT_COMPUTED, symbol, NULL, sumPriceQuantity, sumQuantity, id);
+		}
+		_table.weightedStockPrice(id, vwapValue);
+		if (vwapValue > 0.0) {
+			update.vwapLog      = (long long) std::llround(std::log(vwapValue) * LOG_SCALE);
+			update.contribution = CONTRIBUTION_LOG;
 		} else {
-			cout << "Stock '" << symbol << "' not yet traded on stock '" << _name << "'" << endl; 
+			// A single null VWAP makes the Geometric Mean null
+			update.contribution = CONTRIBUTION_NULL_VWAP;
+			METRICS_COUNT(_metrics, COUNTER_VWAP_NOT_COMPUTED, 1);
+		}
+		update.nextChange = _windows[id].nextChange(now);
+	} else {
+		METRICS_COUNT(_metrics, COUNTER_VWAP_NOT_COMPUTED, 1);
+		diagnostics().report(DIAG_STOCK_NOT_TRADED, symbol, _name, 0, 0, id);
+	}
+}
+
+void StockMarket::computeStocks(size_t begin, size_t end, time_t now, vector<StockUpdate>& updates)
+{
+	// Ratios of the whole range in one loop over the table,
+	// then the VWAP window of each stock
+	_table.computeRatios(_dirtyStocks.data() + begin, end - begin);
+	for (size_t i = begin; i < end; ++i) {
+		computeStock(_dirtyStocks[i], now, updates[i]);
+	}
+}
+
+void StockMarket::applyUpdates(vector<StockUpdate> const& updates)
+{
+	// Patch the sum of the logarithms with the dirty stocks only.
+	// The sum is an integer: the result does not depend on the order
+	// in which the stocks have been computed
+	for (size_t i = 0; i < updates.size(); ++i) {
+		SymbolId           id     = _dirtyStocks[i];
+		StockState&        state  = _states[id];
+		StockUpdate const& update = updates[i];
+		
+		_numTradedStocks -= (state.contribution != CONTRIBUTION_NONE);
+		_numNullVwaps    -= (state.contribution == CONTRIBUTION_NULL_VWAP);
+		_vwapLogSumFixed -= state.vwapLog;
+		
+		state.vwapLog      = update.vwapLog;
+		state.contribution = update.contribution;
+		state.nextChange   = update.nextChange;
+		state.dirty        = false;
+		
+		_numTradedStocks += (state.contribution != CONTRIBUTION_NONE);
+		_numNullVwaps    += (state.contribution == CONTRIBUTION_NULL_VWAP);
+		_vwapLogSumFixed += state.vwapLog;
+		
+		if (state.nextChange != VwapWindow::NO_CHANGE) {
+			_windowChanges.push(WindowChange(state.nextChange, id));
+		}
+		refreshStock(id);
+	}
+	if (_dispatcher) {
+		_dispatcher->post(_dirtyStocks, _table, _symbols);
+	}
+	_dirtyStocks.clear();
+	
+	_vwapLogSum = _numNullVwaps > 0 ? -std::numeric_limits<double>::infinity() :
+				  (double) _vwapLogSumFixed / LOG_SCALE;
+	if (_numTradedStocks > 0) {
+		_geometricMean = std::exp(_vwapLogSum / _numTradedStocks);
+	}
+}
+
+void StockMarket::computeStockValues()
+{
+	METRICS_TIME_SCOPE(_metrics, LATENCY_COMPUTE_STOCK_VALUES);
+	METRICS_COUNT(_metrics, COUNTER_COMPUTE_CYCLES, 1);
+	time_t now = _clock.now();
+	collectWindowChanges(now);
+	flushDirtyTrades();
+	vector<StockUpdate> updates(_dirtyStocks.size());
+	computeStocks(0, _dirtyStocks.size(), now, updates);
+	applyUpdates(updates);
+}
+
+void StockMarket::computeStockValues(ThreadPool& pool)
+{
+	METRICS_TIME_SCOPE(_metrics, LATENCY_COMPUTE_STOCK_VALUES);
+	METRICS_COUNT(_metrics, COUNTER_COMPUTE_CYCLES, 1);
+	time_t now = _clock.now();
+	collectWindowChanges(now);
+	flushDirtyTrades();
+	size_t numDirty  = _dirtyStocks.size();
+	size_t numChunks = (numDirty + COMPUTE_CHUNK_SIZE - 1) / COMPUTE_CHUNK_SIZE;
+	vector<StockUpdate> updates(numDirty);
+	pool.parallelFor(numChunks, [&](size_t chunk) {
+		size_t end = std::min((chunk + 1) * COMPUTE_CHUNK_SIZE, numDirty);
+		computeStocks(chunk * COMPUTE_CHUNK_SIZE, end, now, updates);
+	});
+	applyUpdates(updates);
+}
+
+void StockMarket::flushTrades()
+{
+	for (auto columns : _trades) {
+		columns->flush();
+	}
+}
+
+void StockMarket::flushDirtyTrades()
+{
+	// Only the stocks traded since the last computation have late trades
+	for (auto id : _dirtyStocks) {
+		_trades[id]->flush();
+	}
+}
+
+MetricsSnapshot StockMarket::metrics() const
+{
+#if STOCK_MARKET_METRICS
+	return _metrics.snapshot();
+#else
+	return MetricsSnapshot();
+#endif
+}
+
+BarRange StockMarket::getBars(const char* symbol, time_t resolution, time_t from, time_t to) const
+{
+	return getBars(_symbols.find(symbol), resolution, from, to);
+}
+
+BarRange StockMarket::getBars(SymbolId id, time_t resolution, time_t from, time_t to) const
+{
+	BarRange result;
+	if (id < _stocks.size()) {
+		for (size_t r = 0; r < _barResolutions.size(); ++r) {
+			if (_barResolutions[r] == resolution) {
+				result = _bars[r][id].bars(from, to);
+				break;
+			}
+		}
+	}
+	return result;
+}
+
+double StockMarket::vwap(const char* symbol, time_t from, time_t to) const
+{
+	return vwap(_symbols.find(symbol), from, to);
+}
+
+double StockMarket::vwap(SymbolId id, time_t from, time_t to) const
+{
+	WindowSums sums = vwapSums(id, from, to);
+	return sums.quantity > 0 ? (double) sums.priceQuantity / sums.quantity : 0.0;
+}
+
+WindowSums StockMarket::vwapSums(SymbolId id, time_t from, time_t to) const
+{
+	return id < _trades.size() ? _trades[id]->sums(from, to) : WindowSums();
+}
+
+SubscriptionId StockMarket::subscribe(vector<string> const& symbols, ChangeCallback const& callback)
+{
+	vector<SymbolId> ids;
+	for (auto const& symbol : symbols) {
+		SymbolId id = _symbols.find(symbol.c_str(), symbol.size());
+		if (id != INVALID_SYMBOL) {
+			ids.push_back(id);
+		}
+	}
+	SubscriptionId result = INVALID_SUBSCRIPTION;
+	if (!ids.empty()) {
+		if (!_dispatcher) {
+			_dispatcher = new ChangeDispatcher();
+		}
+		result = _dispatcher->subscribe(ids, callback);
+	}
+	return result;
+}
+
+SubscriptionId StockMarket::subscribe(ChangeFilter const& filter, ChangeCallback const& callback)
+{
+	if (!_dispatcher) {
+		_dispatcher = new ChangeDispatcher();
+	}
+	return _dispatcher->subscribe(filter, callback);
+}
+
+bool StockMarket::unsubscribe(SubscriptionId id)
+{
+	return _dispatcher ? _dispatcher->unsubscribe(id) : false;
+}
+
+void StockMarket::flushNotifications() const
+{
+	if (_dispatcher) {
+		_dispatcher->flush();
+	}
+}
+
+void StockMarket::publish()
+{
+	// Readers look the symbols up in their own copy of the table,
+	// copied again when stocks were added
+	if (!_publishedSymbols || _publishedSymbols->size() != _symbols.size()) {
+		const SymbolTable* previous = _publishedSymbols;
+		_publishedSymbols = new SymbolTable(_symbols);
+		if (previous) {
+			_epochs.retire([previous]() { delete previous; });
+		}
+	}
+	
+	// New versions of the changed stocks, with all their trades
+	_stockVersions.resize(_stocks.size(), NULL);
+	for (auto id : _unpublished) {
+		_states[id].unpublished = false;
+		_trades[id]->flush();
+		Stock* stock = _stocks[id]->clone();
+		_table.copyTo(id, stock);
+		const StockVersion* previous = _stockVersions[id];
+		_stockVersions[id] = new StockVersion(stock, *_trades[id]);
+		if (previous) {
+			_epochs.retire([previous]() { delete previous; });
 		}
 	}
-	if (numTrades > 0) {
-		_geometricMean = (double) std::pow(geometricMeanAcc,  (double) (1.0 / numTrades));
+	_unpublished.clear();
+	
+	MarketVersion* version   = new MarketVersion();
+	version->number          = ++_numVersions;
+	version->geometricMean   = _geometricMean;
+	version->numTradedStocks = _numTradedStocks;
+	version->symbols         = _publishedSymbols;
+	version->stocks          = _stockVersions;
+	const MarketVersion* previous = _version.exchange(version);
+	if (previous) {
+		_epochs.retire([previous]() { delete previous; });
 	}
+	_epochs.collect();
 }
 
 const Stock* StockMarket::findStock(const char* symbol) const
 {
-	Stock* result = NULL;
-	 StocksMap::const_iterator iter = _stocks.find(string(symbol));
-	 if (iter != _stocks.end()) {
-	 	result = (*iter).second;
-	 } 
-	 return result;
+	return findStock(_symbols.find(symbol));
+}
+
+const Stock* StockMarket::findStock(SymbolId id) const
+{
+	return id < _stocks.size() ? _stocks[id] : NULL;
 }
 
-const TradesVec* StockMarket::getTrades(const char* symbol) const
+void StockMarket::refreshStock(SymbolId id)
 {
-	const TradesVec* result = NULL;
-	TradesMap::const_iterator iter = _trades.find(string(symbol));
-	if (iter != _trades.end()) {
-		result =  &(*iter).second;
+	_table.copyTo(id, _stocks[id]);
+}
+
+TradesView StockMarket::getTrades(const char* symbol) const
+{
+	return getTrades(_symbols.find(symbol));
+}
+
+TradesView StockMarket::getTrades(SymbolId id) const
+{
+	TradesView result;
+	if (id < _trades.size() && !_trades[id]->empty()) {
+		result = TradesView(_trades[id]);
 	} 
 	return result;
 }
 
 void StockMarket::printInfo() const
 {
+	// Write the pending diagnostics before the report
+	diagnostics().flush();
+	
 	if (_name && *_name) {
 		cout << "\nPRINTING INFOS AND DATA FOR STOCK: " << _name;
 	}
@@ -173,11 +700,10 @@ void StockMarket::printTrades() const
 	cout << "SYMBOL \tPRICE \tQTY \tBUY_SELL TIMESTAMP \tLOCALTIME" << endl;
 	cout << "-------------------------------------------------------------" << endl;
 	
-	for (auto iter : _trades) {
-		TradesVec stockTrades = iter.second;
-		for (TradesVec::const_iterator i = stockTrades.begin(),
-			e = stockTrades.end(); i != e; ++i) {
-			(*i)->printInfo();
+	for (auto columns : _trades) {
+		TradesView stockTrades(columns);
+		for (size_t i = 0, n = stockTrades.size(); i < n; ++i) {
+			stockTrades.trade(i).printInfo();
 		}
 	}
 	cout << endl;
@@ -188,8 +714,7 @@ void StockMarket::printStockValues() const
 	cout << "\nStock Symbol \tType \tLast Dividend  Fixed Dividend \tPar Value   Price   Yield  Ratio  WeightedStockPrice" << endl;
 	cout << "-----------------------------------------------------------------------------------------------------------" << endl;
 
-	for (auto iter2 : _stocks) {
-		Stock* stock = iter2.second;
+	for (auto stock : stocks()) {
 		stock->printInfo();
 	}
 	cout << endl;
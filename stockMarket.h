@@ -1,7 +1,22 @@
-#ifndef _STOCK_MARKET_H_
+#ifndef _STOCK_MARKET_H
 #define _STOCK_MARKET_H
 
 #include "stockUtil.h"
+#include "tradeStore.h"
+#include "stockTable.h"
+#include "barSeries.h"
+#include "marketClock.h"
+#include "symbolTable.h"
+#include "tradeRecord.h"
+#include "threadPool.h"
+#include "tradeJournal.h"
+#include "marketMetrics.h"
+#include "readSnapshot.h"
+#include "epochManager.h"
+#include "changeDispatcher.h"
+#include <atomic>
+#include <queue>
+#include <functional>
 
 //! Class to hold stock market information and data
 class StockMarket
@@ -19,8 +34,28 @@ class StockMarket
 		const char* getCountry()     const { return _country;  }
 		const double geometricMean() const { return _geometricMean;};
 		
-		StocksMap const&  stocks() const { return _stocks; }
-		TradesMap const&  trades() const { return _trades; }
+		//! Number of traded stocks and sum of the logarithms of their
+		//! 'Volume Weighted Stock Price' used for the last Geometric Mean
+		int          numTradedStocks() const { return _numTradedStocks; }
+		double       vwapLogSum     () const { return _vwapLogSum;      }
+		
+		TradeColumnsVec const& trades () const { return _trades;  }
+		SymbolTable     const& symbols() const { return _symbols; }
+		StockTable      const& table  () const { return _table;   }
+		
+		//! Stocks indexed by symbol identifier, see 'findStock'
+		StocksVec const& stocks() const { return _stocks; }
+		
+		//! Statistics of the arena holding all stocks and trades of this market
+		ArenaStats allocatorStats() const { return _arena.stats(); }
+		
+		//! Statistics of the trade blocks of this market
+		TradeBlockPool const& tradeBlocks() const { return _blockPool; }
+		
+		//! Counters and latency histograms of the ingest and compute paths,
+		//! may be called while other threads add trades or compute.
+		//! Empty when built with STOCK_MARKET_METRICS=0
+		MetricsSnapshot metrics() const;
 		
 		//! Setting
 		void setName(const char* name) {
@@ -33,9 +68,52 @@ class StockMarket
 			_country = country;
 		}
 		
+		//! Clock giving the time at which 'computeStockValues' evaluates the
+		//! VWAP windows, the wall clock by default. The event time of the
+		//! clock follows the timestamps of the trades added
+		MarketClock&       clock()       { return _clock; }
+		MarketClock const& clock() const { return _clock; }
+		
+		//! Journal where stocks and trades are appended once added, or NULL.
+		//! The journal is not owned by the stock market
+		TradeJournal* journal() const { return _journal; }
+		void setJournal(TradeJournal* journal) {
+			_journal = journal;
+		}
+		
+		//! Retention of the trades: expired trades are dropped by whole blocks
+		//! as trades are added, see 'RetentionPolicy'. Setting a policy
+		//! applies it to the trades already added.
+		//! Rolling VWAP windows, bars and the stock values are not affected,
+		//! 'getTrades' and 'vwap' only see the trades kept
+		RetentionPolicy const& retention() const { return _retention; }
+		void setRetention(RetentionPolicy const& policy);
+		
+		//! Apply the retention policy to all stocks, for the stocks not traded
+		//! since their trades got older than the maximum age.
+		//! Returns the number of trades expired
+		size_t expireTrades();
+		
+		//! Number of trades expired since this stock market was created
+		size_t numExpiredTrades() const { return _numExpiredTrades; }
+		
+		//! Maintain the bars of the given resolution in seconds for all stocks,
+		//! from now on and for the trades already added and not expired.
+		//! Returns false if the resolution is not positive or already maintained
+		bool addBarResolution(time_t seconds);
+		
+		std::vector<time_t> const& barResolutions() const { return _barResolutions; }
+		
 		//! Add a stock to this stock market
+		//! The stock symbol gets the next identifier, see 'symbolId'
+		//! Symbols longer than MAX_SYMBOL_LENGTH are accepted but cannot be
+		//! carried by a TradeRecord nor journaled: trade them by identifier
 		//! Returns True if successfully added, otherwise false
 		bool  addStock(const Stock* stock);
+		
+		//! Return the identifier of a registered stock symbol
+		//! or INVALID_SYMBOL if the stock is not registered
+		SymbolId symbolId(const char* symbol) const { return _symbols.find(symbol); }
 			
 		//! Add a trade to the stock market
 		//! Condition: Valid trade pointer, valid stock symbol for the trade and
@@ -43,36 +121,232 @@ class StockMarket
 		//! Returns true if trade added, otherwise 'false'
 		bool addTrade(const Trade* trade);
 		
+		//! Add a trade of the stock with the given identifier.
+		//! Hot ingest path: no symbol lookup. The trade is stored in the trade
+		//! columns and fed to the rolling VWAP window, the bars
+		//! and the journal, and the stock is marked dirty for the computation
+		//! and its notifications. Each of them may allocate when it grows, and
+		//! the retention policy may expire trade blocks
+		bool addTrade(SymbolId  id,
+					  int       price,
+					  int       quantity,
+					  bool      buy,
+					  time_t    timestamp);
+		
+		//! Add trades in bulk. The symbol is looked up once per run of
+		//! consecutive records of the same stock, records giving a symbol
+		//! identifier skip the lookup.
+		//! Returns the number of trades added
+		size_t addTrades(TradeSpan trades);
+		
 		//! top level function to compute all values requested in the assignment
 		//! for each stock registered in the stock market and using the last
 		//! stock price stored.
+		//! The 'Volume Weighted Stock Price' is read from the rolling window
+		//! of each stock, so its cost does not depend on the trades history length.
 		
-		//! The functions iterates over all registered stocks and calls
-		//! APIs defined in stockUtil.h for the class 'Stock'.
+		//! The functions iterates over the 'dirty' stocks only and calls
+		//! APIs defined in stockUtil.h for the class 'Stock'. A stock is dirty
+		//! when it has been added or traded since the last computation, or when
+		//! a trade entered or left its VWAP window since then.
 		//! The function computes and stores the Geometric Mean at the end.
+		//! The Geometric Mean is computed as the exponential of the mean of the
+		//! logarithms. The sum of the logarithms is kept in fixed point and
+		//! patched with the values of the dirty stocks only.
+		//! The late trades of the dirty stocks are merged first, see 'flushTrades'
 		void computeStockValues();
 		
-	    //! Print this stock market infos
+		//! Same as above with the dirty stocks spread over a thread pool, in
+		//! chunks of COMPUTE_CHUNK_SIZE stocks. Results are bit-identical to
+		//! the serial computation whatever the number of threads
+		void computeStockValues(ThreadPool& pool);
+		
+		static const size_t COMPUTE_CHUNK_SIZE = 256;
+		
+		//! Merge the late trades waiting in the reorder buffers of all stocks
+		//! at their place in time, so 'getTrades' sees them
+		void flushTrades();
+		
+		//! Number of stocks to recompute at the next 'computeStockValues'
+		//! not counting the ones whose VWAP window will change by then
+		size_t numDirtyStocks() const { return _dirtyStocks.size(); }
+		
+		//! Write the whole state of this stock market (name, location, country,
+		//! stocks with their computed values and all trades) to a binary snapshot.
+		//! The late trades are merged first, see 'flushTrades'.
+		//! Returns false if the file cannot be written
+		bool saveSnapshot(const char* path);
+		
+		//! Load a snapshot written by 'saveSnapshot' into this stock market,
+		//! which must not hold any stock. The snapshot is memory mapped and
+		//! trades are copied column by column. Name, location and country are
+		//! copied into the arena of the stock market.
+		//! Returns false if the file is not a valid snapshot, in which case
+		//! the stock market may hold the stocks loaded before the error
+		bool loadSnapshot(const char* path);
+		
+	    //! Print this stock market infos, the trades as 'getTrades' sees them
 		void printInfo() const;
 		
+		//! Publish the current values and trades of the stocks for the readers
+		//! of other threads, see 'ReadSnapshot'. Only the stocks changed since
+		//! the last version are copied, their trades are shared. Versions no
+		//! reader can see anymore are freed.
+		//! Called by the thread adding the trades, typically after
+		//! 'computeStockValues'
+		void publish();
+		
+		//! Number of versions published
+		uint64_t numVersions() const { return _numVersions; }
+		
+		//! Subscribe to the changes of the last price and VWAP of the given
+		//! stocks made by 'computeStockValues'. The changes are delivered in
+		//! batches on a dispatcher thread, see 'ChangeDispatcher'.
+		//! Unknown symbols are ignored, returns INVALID_SUBSCRIPTION if no
+		//! symbol is known.
+		//! NOTE: like 'addTrade', subscribing must be done by the thread
+		//! modifying this stock market: the first subscription creates the
+		//! dispatcher the computations post to
+		SubscriptionId subscribe(std::vector<std::string> const& symbols,
+								 ChangeCallback           const& callback);
+		
+		//! Subscribe to the changes of any stock accepted by 'filter',
+		//! e.g. 'vwapMoveAbove(1.0)'
+		SubscriptionId subscribe(ChangeFilter   const& filter,
+								 ChangeCallback const& callback);
+		
+		//! Returns false if the subscription is unknown. May be called from
+		//! the thread modifying this stock market or from a callback
+		bool unsubscribe(SubscriptionId id);
+		
+		//! Wait until the changes of the computations done so far are
+		//! delivered. Returns at once when called from a callback
+		void flushNotifications() const;
+		
 		//! Given a stock symbol, retrieve all (including computed) stock values
-		//! associated with this stock
+		//! associated with this stock.
+		//! The values live in the stock table, the returned stock is a copy
+		//! updated by the thread modifying this stock market: its last price by
+		//! each trade, its computed values by each computation. Reading does not
+		//! modify anything, other threads must use a 'ReadSnapshot' while
+		//! trades are added or values computed
 		const Stock* findStock(const char* symbol) const;
+		const Stock* findStock(SymbolId    id)     const;
 		
-		//! Return a pointer to the vector of all trades of a given symbol
-		const TradesVec* getTrades(const char* symbol) const;
+		//! Return a view over all trades of a given symbol sorted by timestamp.
+		//! Reading does not modify anything: late trades waiting to be merged
+		//! are not in the view until 'flushTrades' or the next computation.
+		//! The view is not valid if the symbol has not been traded
+		TradesView getTrades(const char* symbol) const;
+		TradesView getTrades(SymbolId    id)     const;
+			
+		//! Return the bars of a given resolution holding the trades of a symbol
+		//! timestamped in [from, to], without reading the trades.
+		//! The range is empty if the symbol or the resolution is unknown and
+		//! is invalidated by the next trade of the symbol.
+		//! Bars ending before the oldest trade kept are dropped with the
+		//! expired trades, the bar holding it may still count expired trades
+		BarRange getBars(const char* symbol, time_t resolution, time_t from, time_t to) const;
+		BarRange getBars(SymbolId    id,     time_t resolution, time_t from, time_t to) const;
+			
+		//! Return the 'Volume Weighted Stock Price' of a symbol over its trades
+		//! timestamped in [from, to], for any window, in O(log trades).
+		//! Returns 0 if the symbol is unknown or not traded in the window
+		double vwap(const char* symbol, time_t from, time_t to) const;
+		double vwap(SymbolId    id,     time_t from, time_t to) const;
+		
+		//! Sums of price*quantity and quantity behind 'vwap', so the VWAP of
+		//! trades split over several markets can be merged from their sums
+		WindowSums vwapSums(SymbolId id, time_t from, time_t to) const;
 			
 	private:
+		//! Contribution of a stock to the Geometric Mean
+		enum Contribution {
+			CONTRIBUTION_NONE,       // stock not traded
+			CONTRIBUTION_LOG,        // logarithm of a positive VWAP
+			CONTRIBUTION_NULL_VWAP   // null VWAP, the Geometric Mean is null
+		};
+		
+		//! Incremental computation state of a stock
+		struct StockState {
+			long long     vwapLog;       // fixed point logarithm of the VWAP
+			unsigned char contribution;
+			bool          dirty;
+			bool          unpublished;   // changed since the last version published
+			time_t        nextChange;    // next time a trade enters or leaves the window
+		};
+		
+		//! Result of the computation of a dirty stock
+		struct StockUpdate {
+			long long     vwapLog;
+			unsigned char contribution;
+			time_t        nextChange;
+		};
+		
+		typedef std::pair<time_t, SymbolId> WindowChange;
+		typedef std::priority_queue<WindowChange,
+									std::vector<WindowChange>,
+									std::greater<WindowChange> > WindowChangesQueue;
+		
+		//! Fixed point scale of the logarithms: the sum of the logarithms
+		//! is exact and does not depend on the order of the updates
+		static const long long LOG_SCALE = 1LL << 32;
+		
+		void markDirty         (SymbolId id);
+		void markUnpublished   (SymbolId id);
+		void collectWindowChanges(time_t now);
+		void computeStock      (SymbolId id, time_t now, StockUpdate& update);
+		void applyUpdates      (std::vector<StockUpdate> const& updates);
+		void computeStocks     (size_t begin, size_t end, time_t now,
+								std::vector<StockUpdate>& updates);
+		void refreshStock      (SymbolId id);
+		void flushDirtyTrades  ();
+		void rebuildBars       (size_t resolution, SymbolId id);
+		size_t expireTrades    (SymbolId id);
+		size_t expireBlocks    (SymbolId id, size_t count);
+		size_t expireBytes     ();
+		size_t retainedBytes   () const { return _blockPool.bytesInUse(); }
+		
 		void printTrades     () const;
 		void printStockValues() const;
 		
-		const char* _name;
-		const char* _location;
-		const char* _country;
-		double      _geometricMean;
-		StocksMap   _stocks;
-		TradesMap   _trades;
+		const char*             _name;
+		const char*             _location;
+		const char*             _country;
+		double                  _geometricMean;
+		int                     _numTradedStocks;
+		double                  _vwapLogSum;
+		long long               _vwapLogSumFixed;  // sum of the 'vwapLog' of the stock states
+		int                     _numNullVwaps;
+		Arena                   _arena;           // owns the memory of all stocks and trades
+		TradeBlockPool          _blockPool;       // blocks of the trade columns
+		mutable EpochManager    _epochs;          // of the readers of the published versions
+		SymbolTable             _symbols;
+		StockTable              _table;           // values of the stocks, indexed by symbol identifier
+		StocksVec               _stocks;          // views of the table, indexed by symbol identifier
+		TradeColumnsVec         _trades;          // indexed by symbol identifier
+		WindowsVec              _windows;         // indexed by symbol identifier
+		std::vector<StockState> _states;          // indexed by symbol identifier
+		std::vector<time_t>     _barResolutions;
+		std::vector<BarSeriesVec> _bars;          // indexed by resolution
+		std::vector<SymbolId>   _dirtyStocks;
+		WindowChangesQueue      _windowChanges;
+		TradeJournal*           _journal;
+		MarketClock             _clock;
+		RetentionPolicy         _retention;
+		size_t                  _numExpiredTrades;
+		std::atomic<const MarketVersion*> _version;       // last version published
+		std::vector<const StockVersion*>  _stockVersions; // indexed by symbol identifier
+		const SymbolTable*      _publishedSymbols;
+		std::vector<SymbolId>   _unpublished;
+		uint64_t                _numVersions;
+		ChangeDispatcher*       _dispatcher;      // created by the first subscription, by the writer
+#if STOCK_MARKET_METRICS
+		MarketMetrics           _metrics;
+#endif
 		
+	friend class ReadSnapshot;
+	
 	//! Disable copy constructor and 
 	//! copy assignment operator
 	StockMarket(const StockMarket&);
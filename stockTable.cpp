@@ -0,0 +1,111 @@
+#include "stockTable.h"
+#include "stockUtil.h"
+
+using namespace std;
+
+StockTable::StockTable() :
+			_kinds          (),
+			_lastDividends  (),
+			_fixedDividends (),
+			_parValues      (),
+			_yieldNumerators(),
+			_yieldValid     (),
+			_lastPrices     (),
+			_dividendYields (),
+			_peRatios       (),
+			_weightedPrices ()
+			{}
+
+SymbolId StockTable::add(const Stock* stock)
+{
+	const PreferredStock* preferred = dynamic_cast<const PreferredStock*>(stock);
+	int lastDividend  = stock->lastDividend();
+	int parValue      = stock->parValue();
+	int fixedDividend = preferred ? preferred->fixedDividend() : 0;
+
+	// The dividend of the yield formula only depends on the kind of stock
+	// and its dividends: compute it once here rather than on each price
+	_kinds         .push_back(preferred ? STOCK_PREFERRED : STOCK_COMMON);
+	_lastDividends .push_back(lastDividend);
+	_fixedDividends.push_back(fixedDividend);
+	_parValues     .push_back(parValue);
+	if (preferred) {
+		_yieldNumerators.push_back(0.01 * fixedDividend * parValue);
+		_yieldValid     .push_back(fixedDividend >= 0 && parValue >= 0);
+	} else {
+		_yieldNumerators.push_back((double) lastDividend);
+		_yieldValid     .push_back(lastDividend >= 0);
+	}
+	_lastPrices    .push_back(stock->lastPrice());
+	_dividendYields.push_back(stock->lastDividendYield());
+	_peRatios      .push_back(stock->lastPERatio());
+	_weightedPrices.push_back(stock->weightedStockPrice());
+	return (SymbolId) (_kinds.size() - 1);
+}
+
+void StockTable::computedValues(SymbolId id,
+								double   dividendYield,
+								double   peRatio,
+								double   weightedPrice)
+{
+	_dividendYields[id] = dividendYield;
+	_peRatios      [id] = peRatio;
+	_weightedPrices[id] = weightedPrice;
+}
+
+//! Yield and P/E ratio of one stock, without branches: invalid divisors
+//! are replaced by 1 and the results selected.
+//! Returns the number of invalid values
+static inline size_t computeRatiosAt(size_t               id,
+									 const int*           lastPrices,
+									 const int*           lastDividends,
+									 const double*        yieldNumerators,
+									 const unsigned char* yieldValid,
+									 double*              dividendYields,
+									 double*              peRatios)
+{
+	int    price      = lastPrices[id];
+	int    dividend   = lastDividends[id];
+	bool   validYield = price > 0 && yieldValid[id];
+	bool   validPE    = price >= 0 && dividend > 0;
+	double yield      = yieldNumerators[id] / (validYield ? price : 1);
+	double peRatio    = (double) price / (validPE ? dividend : 1);
+	dividendYields[id] = validYield ? yield   : 0.0;
+	peRatios      [id] = validPE    ? peRatio : 0.0;
+	return !validYield + !validPE;
+}
+
+size_t StockTable::computeRatios(const SymbolId* ids, size_t count)
+{
+	size_t result = 0;
+	for (size_t i = 0; i < count; ++i) {
+		result += computeRatiosAt(ids[i], _lastPrices.data(), _lastDividends.data(),
+								  _yieldNumerators.data(), _yieldValid.data(),
+								  _dividendYields.data(), _peRatios.data());
+	}
+	return result;
+}
+
+size_t StockTable::computeRatios()
+{
+	size_t result = 0;
+	for (size_t id = 0, n = size(); id < n; ++id) {
+		result += computeRatiosAt(id, _lastPrices.data(), _lastDividends.data(),
+								  _yieldNumerators.data(), _yieldValid.data(),
+								  _dividendYields.data(), _peRatios.data());
+	}
+	return result;
+}
+
+void StockTable::copyTo(SymbolId id, Stock* stock) const
+{
+	stock->lastDividend      (_lastDividends [id]);
+	stock->parValue          (_parValues     [id]);
+	stock->lastPrice         (_lastPrices    [id]);
+	stock->lastDividendYield (_dividendYields[id]);
+	stock->lastPERatio       (_peRatios      [id]);
+	stock->weightedStockPrice(_weightedPrices[id]);
+	if (_kinds[id] == STOCK_PREFERRED) {
+		static_cast<PreferredStock*>(stock)->fixedDividend(_fixedDividends[id]);
+	}
+}
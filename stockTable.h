@@ -0,0 +1,74 @@
+#ifndef _STOCK_TABLE_H
+#define _STOCK_TABLE_H
+
+#include "symbolTable.h"
+#include <vector>
+#include <cstddef>
+
+class Stock;
+
+// File declares the dense table holding the values of the stocks of a market.
+// Each value is stored in its own array indexed by symbol identifier and the
+// kind of stock is a tag, so computing the values of many stocks runs as a
+// loop over contiguous arrays without pointer chasing nor virtual calls.
+
+//! Kind of a stock, chooses the formula of the dividend yield
+enum StockKind {
+	STOCK_COMMON,
+	STOCK_PREFERRED
+};
+
+class StockTable
+{
+	public:
+		StockTable();
+
+		//! Accessing
+		size_t    size              ()            const { return _kinds.size();          }
+		StockKind kind              (SymbolId id) const { return (StockKind) _kinds[id]; }
+		int       lastDividend      (SymbolId id) const { return _lastDividends[id];     }
+		int       fixedDividend     (SymbolId id) const { return _fixedDividends[id];    }
+		int       parValue          (SymbolId id) const { return _parValues[id];         }
+		int       lastPrice         (SymbolId id) const { return _lastPrices[id];        }
+		double    lastDividendYield (SymbolId id) const { return _dividendYields[id];    }
+		double    lastPERatio       (SymbolId id) const { return _peRatios[id];          }
+		double    weightedStockPrice(SymbolId id) const { return _weightedPrices[id];    }
+
+		//! Whether the dividend yield and P/E ratio could be computed at the last price
+		bool dividendYieldValid(SymbolId id) const { return _lastPrices[id] > 0 && _yieldValid[id]; }
+		bool peRatioValid      (SymbolId id) const { return _lastPrices[id] >= 0 && _lastDividends[id] > 0; }
+
+		//! Setting
+		void lastPrice         (SymbolId id, int    value) { _lastPrices[id]     = value; }
+		void weightedStockPrice(SymbolId id, double value) { _weightedPrices[id] = value; }
+		void computedValues    (SymbolId id,
+								double   dividendYield,
+								double   peRatio,
+								double   weightedPrice);
+
+		//! Append the values of a stock, returns its identifier (the table size)
+		SymbolId add(const Stock* stock);
+
+		//! Compute the dividend yield and P/E ratio of the given stocks,
+		//! or of all stocks, from their last price. Invalid values are set
+		//! to 0 like in 'Stock'. Returns the number of stocks with an invalid value
+		size_t computeRatios(const SymbolId* ids, size_t count);
+		size_t computeRatios();
+
+		//! Copy the values of a stock into a 'Stock' of the same kind
+		void copyTo(SymbolId id, Stock* stock) const;
+
+	private:
+		std::vector<unsigned char> _kinds;
+		std::vector<int>           _lastDividends;
+		std::vector<int>           _fixedDividends;
+		std::vector<int>           _parValues;
+		std::vector<double>        _yieldNumerators;  // dividend divided by the price for the yield
+		std::vector<unsigned char> _yieldValid;       // yield computable for a positive price
+		std::vector<int>           _lastPrices;
+		std::vector<double>        _dividendYields;
+		std::vector<double>        _peRatios;
+		std::vector<double>        _weightedPrices;
+};
+
+#endif
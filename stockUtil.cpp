@@ -1,5 +1,10 @@
 #include "stockUtil.h"
+#include "tradeStore.h"
+#include "arena.h"
+#include "diagnostics.h"
 #include <iostream>
+#include <limits>
+#include <algorithm>
 
 using namespace std;
 						
@@ -42,13 +47,19 @@ Stock* Stock::clone() const
 	return newStock;
 }
 
+Stock* Stock::clone(Arena& arena) const
+{
+	Stock* newStock = arena.create<Stock>();
+	copyData(newStock);
+	return newStock;
+}
+
 double Stock::computeDividendYield(int price)
 {
 	if (price > 0 && _lastDividend >= 0) {
 		_lastDividendYield = (double) _lastDividend / price ;
 	} else {
-		cout << "Cannot compute Dividend Yield for stock " << _symbol
-		     << " due to invalid values" << endl;
+		diagnostics().report(DIAG_DIVIDEND_YIELD_NOT_COMPUTED, _symbol.c_str(), NULL, price, _lastDividend);
 		_lastDividendYield = 0.0;
 	}
 	return _lastDividendYield;
@@ -59,33 +70,42 @@ double Stock::computePERatio(int price)
 	if (_lastDividend > 0 && price >= 0) {
 		_lastPERatio = (double) price / _lastDividend ;
 	} else {
-		cout << "Cannot compute P/E ratio for stock " << _symbol 
-		     << " due to invalid values" << endl;
+		diagnostics().report(DIAG_PE_RATIO_NOT_COMPUTED, _symbol.c_str(), NULL, price, _lastDividend);
 		_lastPERatio = 0.0;
 	}
 	return _lastPERatio;
 }
 
-double Stock::computeWeightedStockPrice(TradesVec const& trades)
+double Stock::computeWeightedStockPrice(TradesView const& trades)
 {
-	long int sumPriceQuantity = 0;
-	long int sumQuantity      = 0;
-	time_t   rawTime;
+	time_t rawTime;
 	time(&rawTime);
-	for (auto trade : trades) {
-		const time_t& tradeTime = trade->timestamp();
-		int           price     = trade->price();
-		if (tradeTime >= rawTime - 300 && tradeTime <= rawTime) {
-			int quantity = trade->quantity();
-			sumPriceQuantity += price * quantity;
-			sumQuantity      += quantity;
-		} 
+	return computeWeightedStockPrice(trades, rawTime);
+}
+
+double Stock::computeWeightedStockPrice(TradesView const& trades, time_t now)
+{
+	WindowSums sums = trades.sums(now - VWAP_WINDOW_SECONDS, now);
+	
+	if (sums.quantity > 0) {
+		_weightedStockPrice = (double) sums.priceQuantity / sums.quantity;
+	} else {
+		diagnostics().report(DIAG_VWAP_NOT_COMPUTED, _symbol.c_str(), NULL, sums.priceQuantity, sums.quantity);
+		_weightedStockPrice = 0.0;
 	}
+	return _weightedStockPrice;
+}
+
+double Stock::computeWeightedStockPrice(VwapWindow& window, time_t now)
+{
+	long sumPriceQuantity = 0;
+	long sumQuantity      = 0;
+	window.sums(now, sumPriceQuantity, sumQuantity);
 	
 	if (sumQuantity > 0) {
 		_weightedStockPrice = (double) sumPriceQuantity / sumQuantity;
 	} else {
-		cout << "Volume Weighted Stock Price not computed" << endl;
+		diagnostics().report(DIAG_VWAP_NOT_COMPUTED, _symbol.c_str(), NULL, sumPriceQuantity, sumQuantity);
 		_weightedStockPrice = 0.0;
 	}
 	return _weightedStockPrice;
@@ -128,6 +148,13 @@ Stock* PreferredStock::clone() const
 	copyData(newStock);
 	return newStock;
 }
+
+Stock* PreferredStock::clone(Arena& arena) const
+{
+	Stock* newStock = arena.create<PreferredStock>();
+	copyData(newStock);
+	return newStock;
+}
 		
 double PreferredStock::computeDividendYield(int price)
 {
@@ -136,8 +163,7 @@ double PreferredStock::computeDividendYield(int price)
 		double yield = (double) (0.01 * _fixedDividend * parVal) / price;
 		lastDividendYield(yield);
 	} else {
-		cout << "Cannot compute Dividend Yield for stock " << symbol() 
-		     << " due to invalid values" << endl;
+		diagnostics().report(DIAG_DIVIDEND_YIELD_NOT_COMPUTED, symbol().c_str(), NULL, price, lastDividend());
 		lastDividendYield(0.0);
 	}
 	return lastDividendYield();
@@ -180,6 +206,18 @@ Trade::Trade(const char* symbol,
 	time(&_timestamp);
 }
 
+Trade::Trade(const char* symbol,
+			 int         price,
+			 int         quantity,
+			 bool        buy,
+			 time_t      timestamp) :
+			_symbol   (string(symbol)),
+			_price    (price),
+			_quantity (quantity),
+			_timestamp(timestamp),
+			_buy      (buy)
+			{}
+
 void Stock::printInfo() const
 {
 	if (!_symbol.empty()) {
@@ -224,3 +262,87 @@ void Trade::printInfo() const
 			 << endl;
 	}
 }
+
+VwapWindow::VwapWindow(time_t length) :
+			_entries         (),
+			_future          (),
+			_length          (length),
+			_lowerBound      (0),
+			_now             (numeric_limits<time_t>::min()),
+			_sumPriceQuantity(0),
+			_sumQuantity     (0)
+			{}
+
+void VwapWindow::addTrade(time_t timestamp, int price, int quantity)
+{
+	if (timestamp < _lowerBound) {
+		// Trade already out of the window
+		return;
+	}
+	Entry entry;
+	entry.timestamp     = timestamp;
+	entry.priceQuantity = (long) price * quantity;
+	entry.quantity      = quantity;
+	
+	if (timestamp > _now) {
+		// Enters the window when the time reaches it
+		_future.push_back(entry);
+		push_heap(_future.begin(), _future.end());
+		return;
+	}
+	_entries.push_back(entry);
+	push_heap(_entries.begin(), _entries.end());
+	_sumPriceQuantity += entry.priceQuantity;
+	_sumQuantity      += entry.quantity;
+}
+
+void VwapWindow::advance(time_t now)
+{
+	if (now > _now) {
+		_now = now;
+		while (!_future.empty() && _future.front().timestamp <= now) {
+			Entry const& entry = _future.front();
+			_entries.push_back(entry);
+			push_heap(_entries.begin(), _entries.end());
+			_sumPriceQuantity += entry.priceQuantity;
+			_sumQuantity      += entry.quantity;
+			pop_heap(_future.begin(), _future.end());
+			_future.pop_back();
+		}
+	}
+	time_t lowerBound = now - _length;
+	if (lowerBound <= _lowerBound) {
+		return;
+	}
+	_lowerBound = lowerBound;
+	while (!_entries.empty() && _entries.front().timestamp < _lowerBound) {
+		_sumPriceQuantity -= _entries.front().priceQuantity;
+		_sumQuantity      -= _entries.front().quantity;
+		pop_heap(_entries.begin(), _entries.end());
+		_entries.pop_back();
+	}
+}
+
+void VwapWindow::sums(time_t now, long& sumPriceQuantity, long& sumQuantity)
+{
+	advance(now);
+	sumPriceQuantity = _sumPriceQuantity;
+	sumQuantity      = _sumQuantity;
+}
+
+const time_t VwapWindow::NO_CHANGE = numeric_limits<time_t>::max();
+
+time_t VwapWindow::nextChange(time_t now) const
+{
+	(void) now;
+	time_t result = NO_CHANGE;
+	if (!_entries.empty()) {
+		// The oldest trade leaves the window once 'now - length' is after it
+		result = _entries.front().timestamp + _length + 1;
+	}
+	if (!_future.empty() && _future.front().timestamp < result) {
+		// The oldest future trade enters the window at its timestamp
+		result = _future.front().timestamp;
+	}
+	return result;
+}
@@ -1,22 +1,80 @@
 #ifndef _STOCK_UTIL_H
 #define _STOCK_UTIL_H
 
-#include <unordered_map>
 #include <vector>
 #include <string>
 #include "time.h"
 
 // File declares types and classes used to manage the 'Super Simple Stock Market':
 
+class Arena;
 class Stock;
 class Trade;
+class TradesView;
+class VwapWindow;
 
-typedef std::unordered_map<std::string, Stock*>    StocksMap; // maps stock symbol to associated values
-typedef std::vector<Trade*>                        TradesVec; // vector of all trades of a given stock
-typedef std::unordered_map<std::string, TradesVec> TradesMap; // maps stock symbol to all trades of this stock
-typedef StocksMap::iterator                        StocksIter;
-typedef TradesMap::iterator                        TradesMapIter;
-typedef TradesVec::iterator                        TradesIter;
+typedef std::vector<Stock*>     StocksVec;  // stocks indexed by symbol identifier
+typedef std::vector<VwapWindow> WindowsVec; // rolling VWAP windows indexed by symbol identifier
+
+//! Length in seconds of the window used for the 'Volume Weighted Stock Price'
+const time_t VWAP_WINDOW_SECONDS = 300;
+
+//! Rolling window over the trades of a given stock.
+//! Running sums of price*quantity and quantity are updated when a trade
+//! is added and when trades leave the window, so reading the
+//! 'Volume Weighted Stock Price' does not depend on the trade history length.
+//! Trades are kept in a heap ordered by timestamp, so late trades cost
+//! O(log n) to add like the others. Trades timestamped after the last time
+//! the window was advanced to wait in a second heap, not summed, and enter
+//! the window when the time reaches them: replays and future trades cost
+//! O(log n) per trade as well.
+//! NOTE: the window expects the time passed to 'advance' to never go backward
+class VwapWindow
+{
+	public:
+		VwapWindow(time_t length = VWAP_WINDOW_SECONDS);
+		
+		//! Accessing
+		time_t length          () const { return _length;          }
+		size_t size            () const { return _entries.size() + _future.size(); }
+		long   sumPriceQuantity() const { return _sumPriceQuantity; }
+		long   sumQuantity     () const { return _sumQuantity;     }
+		
+		//! Add a trade to the window, trades already out of the window are ignored
+		void addTrade(time_t timestamp, int price, int quantity);
+		
+		//! Enter the future trades timestamped up to 'now' and drop all
+		//! trades older than 'now - length' from the window
+		void advance(time_t now);
+		
+		//! Compute the sums of the trades in [now - length, now].
+		//! Trades timestamped after 'now' stay in the window but are not counted
+		void sums(time_t now, long& sumPriceQuantity, long& sumQuantity);
+		
+		//! Next time after 'now' at which a trade leaves the window or a
+		//! future trade enters it, NO_CHANGE if the window is empty.
+		//! 'now' is the time the window was last advanced to
+		time_t nextChange(time_t now) const;
+		
+		static const time_t NO_CHANGE;
+		
+	private:
+		struct Entry {
+			time_t timestamp;
+			long   priceQuantity;
+			int    quantity;
+			
+			//! Order of the heap: the oldest trade on top
+			bool operator<(Entry const& other) const { return timestamp > other.timestamp; }
+		};
+		std::vector<Entry> _entries;  // binary heap, the oldest trade first
+		std::vector<Entry> _future;   // binary heap of the trades after '_now', the oldest first
+		time_t             _length;
+		time_t             _lowerBound;    // trades older than this already left the window
+		time_t             _now;           // time the window was last advanced to
+		long               _sumPriceQuantity;  // of '_entries' only
+		long               _sumQuantity;
+};
 
 class Stock
 {
@@ -31,6 +89,10 @@ class Stock
 		//! Funtion implementing a 'virtual constructor' for 'Stock' class hierarchy
 		virtual Stock* clone() const;
 		
+		//! Same as above with the new stock allocated in the given arena.
+		//! The stock must be destroyed by calling its destructor, not 'delete'
+		virtual Stock* clone(Arena& arena) const;
+		
 		//! Accessing
 		std::string const& symbol     () const { return _symbol;            }
 		int         lastDividend      () const { return _lastDividend;      }
@@ -62,7 +124,14 @@ class Stock
 		double computePERatio(int price);
 			
 		// Compute the 'Volume Weighted Stock Price' for this stock trades
-		double computeWeightedStockPrice(TradesVec const& trades);
+		double computeWeightedStockPrice(TradesView const& trades);
+		
+		// Same as above with the window ending at 'now' instead of the system time
+		double computeWeightedStockPrice(TradesView const& trades, time_t now);
+		
+		// Compute the 'Volume Weighted Stock Price' from the rolling window
+		// of this stock trades, at time 'now'
+		double computeWeightedStockPrice(VwapWindow& window, time_t now);
 		
 		// Utility function to copy all data members into a new Stock
 		virtual void copyData(Stock* dest) const;
@@ -92,9 +161,10 @@ class PreferredStock: public Stock
 		~PreferredStock() {}
 		
 		Stock* clone() const;
+		Stock* clone(Arena& arena) const;
 		
 			//! Accessing
-		int fixedDividend() { return _fixedDividend; }
+		int fixedDividend() const { return _fixedDividend; }
 		
 		//! Setting 
 		void fixedDividend(int value) { _fixedDividend = value; }
@@ -121,6 +191,13 @@ class Trade
 			  int   	  price,
 		      int         quantity,
 			  bool        buy);
+		
+		//! Same as above with the given timestamp instead of the system time
+		Trade(const char* symbol,
+			  int         price,
+			  int         quantity,
+			  bool        buy,
+			  time_t      timestamp);
 		virtual ~Trade() { }
 		
 		
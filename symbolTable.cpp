@@ -0,0 +1,81 @@
+#include "symbolTable.h"
+#include <cstring>
+
+using namespace std;
+
+SymbolTable::SymbolTable() :
+			_names (),
+			_hashes(),
+			_slots (16, INVALID_SYMBOL)
+			{}
+
+size_t SymbolTable::hash(const char* symbol, size_t length)
+{
+	// FNV-1a
+	size_t result = 14695981039346656037ULL;
+	for (size_t i = 0; i < length; ++i) {
+		result ^= (unsigned char) symbol[i];
+		result *= 1099511628211ULL;
+	}
+	return result;
+}
+
+size_t SymbolTable::slot(const char* symbol, size_t length, size_t hashValue) const
+{
+	size_t mask = _slots.size() - 1;
+	size_t i    = hashValue & mask;
+	while (_slots[i] != INVALID_SYMBOL) {
+		SymbolId id = _slots[i];
+		if (_hashes[id] == hashValue && 
+			_names[id].size() == length &&
+			memcmp(_names[id].data(), symbol, length) == 0) {
+			break;
+		}
+		i = (i + 1) & mask;
+	}
+	return i;
+}
+
+SymbolId SymbolTable::find(const char* symbol) const
+{
+	return symbol ? find(symbol, strlen(symbol)) : INVALID_SYMBOL;
+}
+
+SymbolId SymbolTable::find(const char* symbol, size_t length) const
+{
+	return _slots[slot(symbol, length, hash(symbol, length))];
+}
+
+SymbolId SymbolTable::intern(const char* symbol)
+{
+	size_t length    = strlen(symbol);
+	size_t hashValue = hash(symbol, length);
+	size_t i         = slot(symbol, length, hashValue);
+	if (_slots[i] != INVALID_SYMBOL) {
+		return _slots[i];
+	}
+	SymbolId id = (SymbolId) _names.size();
+	_names .push_back(string(symbol, length));
+	_hashes.push_back(hashValue);
+	_slots[i] = id;
+	
+	// Keep the load factor under 1/2
+	if (2 * _names.size() > _slots.size()) {
+		grow();
+	}
+	return id;
+}
+
+void SymbolTable::grow()
+{
+	vector<SymbolId> slots(2 * _slots.size(), INVALID_SYMBOL);
+	size_t mask = slots.size() - 1;
+	for (SymbolId id = 0; id < _names.size(); ++id) {
+		size_t i = _hashes[id] & mask;
+		while (slots[i] != INVALID_SYMBOL) {
+			i = (i + 1) & mask;
+		}
+		slots[i] = id;
+	}
+	_slots.swap(slots);
+}
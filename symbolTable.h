@@ -0,0 +1,49 @@
+#ifndef _SYMBOL_TABLE_H
+#define _SYMBOL_TABLE_H
+
+#include <vector>
+#include <string>
+#include <cstddef>
+
+// File declares the intern table of the stock symbols of a stock market.
+// Each registered symbol gets a dense integer identifier, used to index
+// the stocks and trades of the market without hashing strings.
+
+typedef unsigned int SymbolId;
+
+//! Identifier returned for unknown symbols
+const SymbolId INVALID_SYMBOL = (SymbolId) -1;
+
+//! Open addressing hash table mapping symbols to dense identifiers.
+//! Looking up a symbol does not allocate memory.
+class SymbolTable
+{
+	public:
+		SymbolTable();
+		
+		//! Accessing
+		size_t             size() const { return _names.size(); }
+		std::string const& name(SymbolId id) const { return _names[id]; }
+		
+		//! Return the identifier of a symbol, or INVALID_SYMBOL if not registered
+		SymbolId find(const char* symbol) const;
+		SymbolId find(const char* symbol, size_t length) const;
+		
+		//! Return the identifier of a symbol, registering the symbol if needed.
+		//! Identifiers are given in registration order starting from 0
+		SymbolId intern(const char* symbol);
+		
+		//! Hash function used for the symbols (FNV-1a)
+		static size_t hash(const char* symbol, size_t length);
+		
+	private:
+		//! Slot holding the symbol or the empty slot where it should be added
+		size_t slot(const char* symbol, size_t length, size_t hashValue) const;
+		void   grow();
+		
+		std::vector<std::string> _names;   // indexed by identifier
+		std::vector<size_t>      _hashes;  // indexed by identifier
+		std::vector<SymbolId>    _slots;   // INVALID_SYMBOL for empty slots
+};
+
+#endif
@@ -1,10 +1,55 @@
 #include "testUtil.h"
 #include "stockMarket.h"
 #include "stockUtil.h"
+#include "tradeJournal.h"
+#include "readSnapshot.h"
+#include "exchangeEngine.h"
+#include "orderBook.h"
+#include "tradeIngestor.h"
+#include "tradeLoader.h"
+#include "windowKernels.h"
 #include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <random>
 
 using namespace std;
 
+//! Register a stock to a market, returns its symbol identifier
+static SymbolId addTestStock(StockMarket& stockMarket, const char* symbol)
+{
+	Stock stock(symbol, 1, 100);
+	stockMarket.addStock(&stock);
+	return stockMarket.symbolId(symbol);
+}
+
+//! Compare the trades of a symbol in two markets, late trades merged
+static bool sameTrades(StockMarket& first, StockMarket& second, const char* symbol)
+{
+	first .flushTrades();
+	second.flushTrades();
+	TradesView a = first .getTrades(symbol);
+	TradesView b = second.getTrades(symbol);
+	bool result = a.valid() && b.valid() && a.size() == b.size();
+	for (size_t i = 0; result && i < a.size(); ++i) {
+		result = a.timestamp(i) == b.timestamp(i) && a.price (i) == b.price (i) &&
+				 a.quantity (i) == b.quantity (i) && a.buying(i) == b.buying(i);
+	}
+	return result;
+}
+
+Tester::Tester() :
+		_numPasses(0),
+		_numFails (0)
+		{}
+
 void Tester::addStockData(StockMarket& stockMarket)
 {
 	Stock stock1;
@@ -147,3 +192,906 @@ bool Tester::checkStock(const char*  symbol,
  	}
 	return result;
 }
+
+void Tester::expect(bool condition, const char* name)
+{
+	if (condition) {
+		_numPasses++;
+	} else {
+		cout << "Test for " << name << " fails" << endl;
+		_numFails++;
+	}
+}
+
+void Tester::checkComponents()
+{
+	_numPasses = 0;
+	_numFails  = 0;
+	
+	checkVwapWindow();
+	checkRetention();
+	checkReadSnapshot();
+	checkLateTrades();
+	checkNotifications();
+	checkExchangeEngine();
+	checkOrderBook();
+	checkIngestion();
+	checkPersistence();
+	checkTradeLoader();
+	checkWindowKernels();
+	
+	cout << "----------------------------------------------" << endl;
+	cout << _numPasses << " Component tests pass" << endl;
+	cout << _numFails  << " Component tests fails" << endl;
+}
+
+void Tester::checkVwapWindow()
+{
+	// Trades after the time of the window wait until the time reaches them
+	VwapWindow window(300);
+	long       sumPriceQuantity = 0;
+	long       sumQuantity      = 0;
+	window.addTrade(1000, 10, 1);
+	window.addTrade(1200, 20, 1);
+	window.addTrade( 900, 30, 1);
+	window.sums(1000, sumPriceQuantity, sumQuantity);
+	expect(sumPriceQuantity == 40 && sumQuantity == 2 && window.nextChange(1000) == 1200,
+		   "VWAP window not counting the future trades");
+	window.addTrade(1100, 40, 1);
+	window.sums(1150, sumPriceQuantity, sumQuantity);
+	expect(sumPriceQuantity == 80 && sumQuantity == 3 && window.nextChange(1150) == 1200,
+		   "VWAP window counting the late trades");
+	window.sums(1250, sumPriceQuantity, sumQuantity);
+	expect(sumPriceQuantity == 70 && sumQuantity == 3 && window.size() == 3 && window.nextChange(1250) == 1301,
+		   "VWAP window entering the future trades and dropping the old ones");
+}
+
+void Tester::checkRetention()
+{
+	const time_t base = 1500000000;
+	
+	// By age: one trade per second, bars of a minute
+	{
+		StockMarket     market;
+		SymbolId        id = addTestStock(market, "AAA");
+		RetentionPolicy policy;
+		policy.maxAge = 600;
+		market.setRetention(policy);
+		market.addBarResolution(60);
+		for (int i = 0; i < 20000; ++i) {
+			market.addTrade(id, 100 + i % 10, 1, true, base + i);
+		}
+		TradesView        trades = market.getTrades(id);
+		TradeBlock const& oldest = trades.block(0);
+		time_t            first  = trades.timestamp(0);
+		time_t            last   = trades.timestamp(trades.size() - 1);
+		BarRange          bars   = market.getBars(id, 60, base, last);
+		expect(market.numExpiredTrades() > 0, "maxAge expiring trades");
+		expect(trades.size() + market.numExpiredTrades() == 20000, "maxAge keeping the other trades");
+		expect(oldest.timestamps[oldest.count - 1] >= last - policy.maxAge, "maxAge keeping no block older than the maximum age");
+		expect(!bars.empty() && bars[0].start + 60 > first, "bars expiring with the trades");
+		expect(bars.size() <= (size_t) (last - first) / 60 + 2, "bars holding the trades kept only");
+	}
+	
+	// By count: the newest trades are kept by whole blocks
+	{
+		StockMarket     market;
+		SymbolId        id = addTestStock(market, "AAA");
+		RetentionPolicy policy;
+		policy.maxTradesPerStock = 1000;
+		market.setRetention(policy);
+		for (int i = 0; i < 20000; ++i) {
+			market.addTrade(id, 100, 1, true, base + i);
+		}
+		TradesView trades = market.getTrades(id);
+		expect(trades.size() >= policy.maxTradesPerStock &&
+			   trades.size() <  policy.maxTradesPerStock + TradeColumns::MAX_BLOCK_SIZE, "maxTradesPerStock bounding the trades kept");
+		expect(trades.timestamp(0) == base + 20000 - (time_t) trades.size(), "maxTradesPerStock expiring the oldest trades first");
+	}
+	
+	// By size: the blocks of the market stay in the budget, each stock
+	// keeping the block it writes. The running sums of the trades kept
+	// still give the VWAP of any window
+	{
+		StockMarket     market;
+		SymbolId        first  = addTestStock(market, "AAA");
+		SymbolId        second = addTestStock(market, "BBB");
+		RetentionPolicy policy;
+		policy.maxBytes = 1 << 19;
+		market.setRetention(policy);
+		for (int i = 0; i < 100000; ++i) {
+			market.addTrade(i % 3 ? first : second, 100 + i % 7, 1 + i % 5, true, base + i);
+		}
+		TradesView trades = market.getTrades(first);
+		WindowSums sums;
+		for (size_t k = 0; k < trades.numBlocks(); ++k) {
+			TradeBlock const& block = trades.block(k);
+			windowSumsScalar(block.timestamps, block.prices, block.quantities, trades.blockSize(k),
+							 base + 95000, base + 99000, sums);
+		}
+		expect(market.numExpiredTrades() > 0, "maxBytes expiring trades");
+		expect(market.tradeBlocks().bytesInUse() <= policy.maxBytes, "maxBytes bounding the trade blocks");
+		expect(trades.timestamp(0) < base + 95000 && sums.quantity > 0 &&
+			   market.vwap("AAA", base + 95000, base + 99000) == (double) sums.priceQuantity / sums.quantity,
+			   "maxBytes keeping the VWAP of the trades kept");
+	}
+	
+	// By size after loading a snapshot: about as many trades are kept as
+	// when they are all added to the market
+	{
+		const char*     path = "retentionSnapshot.snp";
+		StockMarket     saved;
+		StockMarket     live;
+		SymbolId        id = addTestStock(saved, "AAA");
+		RetentionPolicy policy;
+		policy.maxBytes = 1 << 19;
+		addTestStock(live, "AAA");
+		live.setRetention(policy);
+		for (int i = 0; i < 40000; ++i) {
+			if (i < 20000) {
+				saved.addTrade(id, 100 + i % 7, 1, true, base + i);
+			}
+			live.addTrade(id, 100 + i % 7, 1, true, base + i);
+		}
+		size_t liveKept = live.getTrades(id).size();
+		bool        written = saved.saveSnapshot(path);
+		StockMarket market;
+		market.setRetention(policy);
+		bool        loaded = market.loadSnapshot(path);
+		size_t      expiredByLoad = market.numExpiredTrades();
+		for (int i = 20000; i < 40000; ++i) {
+			market.addTrade(id, 100 + i % 7, 1, true, base + i);
+		}
+		size_t kept = market.getTrades(id).size();
+		expect(written && loaded && expiredByLoad > 0 && market.tradeBlocks().bytesInUse() <= policy.maxBytes,
+			   "maxBytes expiring the trades of a snapshot");
+		expect(kept + TradeColumns::MAX_BLOCK_SIZE >= liveKept && kept <= liveKept + TradeColumns::MAX_BLOCK_SIZE &&
+			   kept + market.numExpiredTrades() == 40000, "maxBytes keeping the trades of a snapshot");
+		remove(path);
+	}
+	
+	// Bars partly expired, the oldest ones kept until they are the larger part
+	{
+		BarSeries series(60);
+		for (int i = 0; i < 6000; ++i) {
+			series.addTrade(base + i, 100 + i % 10, 1);
+		}
+		series.expire(base + 1200);
+		BarRange all    = series.bars(base, base + 100000);
+		BarRange recent = series.bars(base + 5000, base + 5999);
+		expect(series.size() == 80 && all.size() == 80 && all.begin()->start == base + 1200 &&
+			   (all.end() - 1)->start == base + 5940 && recent.size() == 17 && recent.begin()->start == base + 4980,
+			   "bars queried once partly expired");
+	}
+	
+	// Expired trades are appended to the archive journal, oldest first
+	{
+		const char*     path = "retentionArchive.jnl";
+		StockMarket     market;
+		SymbolId        id = addTestStock(market, "AAA");
+		TradeJournal    archive;
+		RetentionPolicy policy;
+		remove(path);
+		expect(archive.open(path), "archive opening");
+		policy.maxTradesPerStock = 100;
+		policy.archive           = &archive;
+		market.setRetention(policy);
+		for (int i = 0; i < 1000; ++i) {
+			market.addTrade(id, 100 + i, 1, i % 2 == 0, base + i);
+		}
+		expect(market.numExpiredTrades() > 0 && archive.numRecords() == market.numExpiredTrades(),
+			   "archive receiving each expired trade");
+		if (archive.numRecords() > 0) {
+			JournalRecord const& record = archive.record(0);
+			expect(record.kind == JOURNAL_TRADE && strcmp(record.symbol, "AAA") == 0 &&
+				   record.price == 100 && record.buy == 1 && record.timestamp == base,
+				   "archive starting with the oldest trade");
+		}
+		archive.close();
+		remove(path);
+	}
+}
+
+void Tester::checkReadSnapshot()
+{
+	const time_t base = 1500000000;
+	
+	StockMarket market;
+	SymbolId    id = addTestStock(market, "AAA");
+	for (int i = 0; i < 200; ++i) {
+		market.addTrade(id, 100 + i, 1 + i % 3, true, base + 2 * i);
+	}
+	market.computeStockValues();
+	market.publish();
+	
+	size_t freeWhileReading = 0;
+	{
+		ReadSnapshot   snapshot(market);
+		TradesView     trades    = snapshot.getTrades("AAA");
+		uint64_t       version   = snapshot.version();
+		int            lastPrice = snapshot.findStock("AAA")->lastPrice();
+		vector<time_t> timestamps;
+		vector<int>    prices;
+		for (size_t i = 0; i < trades.size(); ++i) {
+			timestamps.push_back(trades.timestamp(i));
+			prices    .push_back(trades.price(i));
+		}
+		
+		// The writer goes on: a newer version, a late trade merged into
+		// the published blocks, the published blocks expired, then new
+		// blocks for other stocks, which would reuse the expired ones
+		for (int i = 200; i < 300; ++i) {
+			market.addTrade(id, 100 + i, 1, false, base + 2 * i);
+		}
+		market.computeStockValues();
+		market.publish();
+		market.addTrade(id, 1, 1, true, base + 1);
+		market.flushTrades();
+		RetentionPolicy policy;
+		policy.maxTradesPerStock = 50;
+		market.setRetention(policy);
+		market.setRetention(RetentionPolicy());
+		market.publish();
+		const char* others[] = { "BBB", "CCC", "DDD", "EEE" };
+		for (size_t k = 0; k < 4; ++k) {
+			SymbolId other = addTestStock(market, others[k]);
+			for (int i = 0; i < 300; ++i) {
+				market.addTrade(other, 7, 7, true, base + 1000 + i);
+			}
+		}
+		market.computeStockValues();
+		market.publish();
+		
+		bool unchanged = snapshot.version() == version && trades.size() == timestamps.size() &&
+						 snapshot.findStock("AAA")->lastPrice() == lastPrice;
+		for (size_t i = 0; unchanged && i < trades.size(); ++i) {
+			unchanged = trades.timestamp(i) == timestamps[i] && trades.price(i) == prices[i];
+		}
+		expect(market.numExpiredTrades() > 0 && market.numVersions() == version + 3, "writer publishing while read");
+		expect(unchanged, "read snapshot unchanged by the writer");
+		freeWhileReading = market.tradeBlocks().bytesFree();
+	}
+	
+	// The blocks read by the snapshot are reused once it is gone
+	market.publish();
+	expect(market.tradeBlocks().bytesFree() > freeWhileReading, "blocks recycled once the reader left");
+}
+
+void Tester::checkLateTrades()
+{
+	const time_t base = 1500000000;
+	
+	// Trades late by up to several blocks, on a few timestamps so many are
+	// equal, merged while versions read the published blocks. Reference:
+	// all trades sorted by timestamp, equal ones in arrival order
+	struct Reference {
+		time_t timestamp;
+		int    price;
+		int    quantity;
+		bool   buy;
+	};
+	StockMarket       market;
+	SymbolId          id = addTestStock(market, "AAA");
+	mt19937           generator(2024);
+	vector<Reference> reference;
+	time_t            now         = base;
+	bool              unchanged   = true;
+	bool              sumsWaiting = true;
+	for (int round = 0; round < 8; ++round) {
+		for (int i = 0; i < 1500; ++i) {
+			now += generator() % 4 == 0 ? 1 : 0;
+			Reference trade = { now, (int) (generator() % 1000), 1 + (int) (generator() % 9), generator() % 2 == 0 };
+			if (generator() % 8 == 0) {
+				trade.timestamp -= (time_t) (generator() % (round % 2 ? 40 : 400));
+			}
+			reference.push_back(trade);
+			market.addTrade(id, trade.price, trade.quantity, trade.buy, trade.timestamp);
+		}
+		
+		// Trades still waiting count in the sums of the windows
+		WindowSums expected;
+		for (size_t i = 0; i < reference.size(); ++i) {
+			if (reference[i].timestamp >= now - 100 && reference[i].timestamp <= now - 20) {
+				expected.priceQuantity += (int64_t) reference[i].price * reference[i].quantity;
+				expected.quantity      += reference[i].quantity;
+			}
+		}
+		WindowSums sums = market.vwapSums(id, now - 100, now - 20);
+		sumsWaiting = sumsWaiting && sums.priceQuantity == expected.priceQuantity && sums.quantity == expected.quantity;
+		
+		// A version read while older trades are merged into its blocks
+		market.publish();
+		ReadSnapshot   snapshot(market);
+		TradesView     published = snapshot.getTrades("AAA");
+		vector<time_t> timestamps;
+		vector<int>    prices;
+		for (size_t i = 0; i < published.size(); ++i) {
+			timestamps.push_back(published.timestamp(i));
+			prices    .push_back(published.price(i));
+		}
+		for (int i = 0; i < 100; ++i) {
+			Reference trade = { now - 600 + (time_t) (generator() % 600), (int) (generator() % 1000), 1, true };
+			reference.push_back(trade);
+			market.addTrade(id, trade.price, trade.quantity, trade.buy, trade.timestamp);
+		}
+		market.flushTrades();
+		for (size_t i = 0; unchanged && i < published.size(); ++i) {
+			unchanged = published.timestamp(i) == timestamps[i] && published.price(i) == prices[i];
+		}
+	}
+	
+	stable_sort(reference.begin(), reference.end(), [](Reference const& a, Reference const& b) {
+		return a.timestamp < b.timestamp;
+	});
+	TradesView trades = market.getTrades(id);
+	bool       sorted = trades.size() == reference.size();
+	for (size_t i = 0; sorted && i < trades.size(); ++i) {
+		sorted = trades.timestamp(i) == reference[i].timestamp && trades.price (i) == reference[i].price &&
+				 trades.quantity (i) == reference[i].quantity  && trades.buying(i) == reference[i].buy;
+	}
+	
+	// Running sums of every window starting and ending on a trade
+	bool summed = true;
+	for (size_t i = 0; summed && i < reference.size(); i += 97) {
+		int64_t priceQuantity = 0;
+		int64_t quantity      = 0;
+		for (size_t j = i; j < reference.size() && j < i + 5000; ++j) {
+			priceQuantity += (int64_t) reference[j].price * reference[j].quantity;
+			quantity      += reference[j].quantity;
+			// Windows holding all trades of their first and last timestamps
+			if ((i == 0 || reference[i - 1].timestamp != reference[i].timestamp) &&
+				(j + 1 == reference.size() || reference[j + 1].timestamp != reference[j].timestamp)) {
+				WindowSums sums = trades.sums(reference[i].timestamp, reference[j].timestamp);
+				summed = summed && sums.priceQuantity == priceQuantity && sums.quantity == quantity;
+			}
+		}
+	}
+	expect(sumsWaiting, "VWAP sums counting the late trades waiting");
+	expect(unchanged,   "published trades unchanged by the late trades merged");
+	expect(sorted,      "late trades merged at their place in time, equal ones in arrival order");
+	expect(summed,      "running sums of the trades merged");
+}
+
+void Tester::checkNotifications()
+{
+	const time_t         base = 1500000000;
+	const vector<string> symbols(1, "AAA");
+	
+	// Changes posted while the dispatcher is late are coalesced into one
+	// change per stock, from the values last delivered to the latest ones
+	{
+		StockMarket market;
+		SymbolId    id = addTestStock(market, "AAA");
+		market.clock().setMode(CLOCK_EVENT);
+		mutex        lock;
+		StockChanges received;
+		atomic<bool> delivering(false);
+		atomic<bool> released  (false);
+		market.subscribe(symbols, [&](StockChanges const& batch) {
+			delivering = true;
+			while (!released) {
+				this_thread::yield();
+			}
+			lock_guard<mutex> guard(lock);
+			received.insert(received.end(), batch.begin(), batch.end());
+		});
+		market.addTrade(id, 100, 1, true, base);
+		market.computeStockValues();
+		while (!delivering) {
+			this_thread::yield();
+		}
+		for (int price = 101; price <= 110; ++price) {
+			market.addTrade(id, price, 1, true, base + price);
+			market.computeStockValues();
+		}
+		released = true;
+		market.flushNotifications();
+		lock_guard<mutex> guard(lock);
+		expect(received.size() == 2 && received[0].lastPrice == 100 &&
+			   received[1].previousPrice == 100 && received[1].lastPrice == 110, "coalescing the changes of a late dispatcher");
+	}
+	
+	// Filters measure the moves from the values last notified to the
+	// subscription: small steps add up until the threshold is crossed
+	{
+		StockMarket market;
+		SymbolId    id = addTestStock(market, "AAA");
+		market.clock().setMode(CLOCK_EVENT);
+		mutex        lock;
+		StockChanges prices;
+		StockChanges vwaps;
+		market.subscribe(priceMoveAbove(5.0), [&](StockChanges const& batch) {
+			lock_guard<mutex> guard(lock);
+			prices.insert(prices.end(), batch.begin(), batch.end());
+		});
+		market.subscribe(vwapMoveAbove(5.0), [&](StockChanges const& batch) {
+			lock_guard<mutex> guard(lock);
+			vwaps.insert(vwaps.end(), batch.begin(), batch.end());
+		});
+		const int steps[] = { 100, 103, 104, 106, 110, 112 };
+		for (size_t i = 0; i < 6; ++i) {
+			market.addTrade(id, steps[i], 1, true, base + i);
+			market.computeStockValues();
+			market.flushNotifications();
+		}
+		lock_guard<mutex> guard(lock);
+		expect(prices.size() == 2 &&
+			   prices[0].previousPrice == 100 && prices[0].lastPrice == 106 &&
+			   prices[1].previousPrice == 106 && prices[1].lastPrice == 112, "priceMoveAbove measuring from the last notified price");
+		expect(vwaps.size() == 1 && vwaps[0].previousVwap == 100.0 &&
+			   fabs(vwaps[0].weightedStockPrice - 635.0 / 6) < 1e-9, "vwapMoveAbove measuring from the last notified VWAP");
+	}
+	
+	// Unsubscribing from another thread waits for the delivery in progress,
+	// unsubscribing or flushing from a callback returns at once
+	{
+		StockMarket    market;
+		SymbolId       id = addTestStock(market, "AAA");
+		atomic<bool>   delivering(false);
+		atomic<bool>   released  (false);
+		atomic<int>    numBlocked(0);
+		atomic<int>    numSelf   (0);
+		atomic<bool>   removed   (false);
+		SubscriptionId self      = INVALID_SUBSCRIPTION;
+		SubscriptionId blocked   = market.subscribe(symbols, [&](StockChanges const&) {
+			delivering = true;
+			while (!released) {
+				this_thread::yield();
+			}
+			numBlocked++;
+			delivering = false;
+		});
+		self = market.subscribe(symbols, [&](StockChanges const&) {
+			numSelf++;
+			market.flushNotifications();
+			removed = market.unsubscribe(self);
+		});
+		market.addTrade(id, 100, 1, true, base);
+		market.computeStockValues();
+		while (!delivering) {
+			this_thread::yield();
+		}
+		thread releaser([&]() {
+			this_thread::sleep_for(chrono::milliseconds(20));
+			released = true;
+		});
+		bool waited = market.unsubscribe(blocked) && !delivering && numBlocked == 1;
+		releaser.join();
+		market.addTrade(id, 120, 1, true, base + 1);
+		market.computeStockValues();
+		market.flushNotifications();
+		expect(waited && numBlocked == 1, "unsubscribing during a delivery");
+		expect(removed && numSelf == 1 && !market.unsubscribe(self), "unsubscribing from a callback");
+	}
+}
+
+//! Push a trade to the engine, to the first market listing its symbol
+//! or to the given market
+static bool pushTrade(ExchangeEngine& engine, MarketId market, const char* symbol, int price, int quantity)
+{
+	TradeRecord record;
+	setTradeRecord(record, symbol, price, quantity, true, 1500000000);
+	return market == INVALID_MARKET ? engine.push(record) : engine.push(market, record);
+}
+
+void Tester::checkExchangeEngine()
+{
+	// London and Frankfurt, both listing SIE
+	StockMarket london   ("FTSE100", "London",    "UK");
+	StockMarket frankfurt("DAX",     "Frankfurt", "Germany");
+	addTestStock(london,    "TEA");
+	addTestStock(london,    "SIE");
+	addTestStock(frankfurt, "BMW");
+	addTestStock(frankfurt, "SIE");
+	london   .clock().setMode(CLOCK_EVENT);
+	frankfurt.clock().setMode(CLOCK_EVENT);
+	
+	ExchangeEngine engine;
+	MarketId       first  = engine.addMarket(london);
+	MarketId       second = engine.addMarket(frankfurt);
+	engine.start();
+	expect(engine.numListings("SIE") == 2 && engine.numListings("TEA") == 1 &&
+		   engine.numListings("BMW") == 1 && engine.numListings("ALE") == 0, "routing the symbols of all markets");
+	
+	// By symbol a trade goes to the first market listing it
+	bool routed = pushTrade(engine, INVALID_MARKET, "TEA", 10, 1) &&
+				  pushTrade(engine, INVALID_MARKET, "BMW", 20, 1) &&
+				  pushTrade(engine, INVALID_MARKET, "SIE", 30, 1) &&
+				  pushTrade(engine, second,         "SIE", 60, 3);
+	bool refused = !pushTrade(engine, INVALID_MARKET, "ALE", 40, 1) &&
+				   !pushTrade(engine, second,         "TEA", 40, 1) &&
+				   engine.numUnrouted() == 2;
+	engine.computeAll();
+	expect(routed && refused, "pushing trades by symbol and by market");
+	expect(engine.vwap("SIE") == (30.0 * 1 + 60.0 * 3) / 4 && engine.vwap("TEA") == 0.0,
+		   "merging the VWAP of a dual listed symbol");
+	double mean = exp((log(10.0) + log(30.0) + log(20.0) + log(60.0)) / 4);
+	expect(engine.numTradedStocks() == 4 && fabs(engine.geometricMean() - mean) < 1e-6 * mean,
+		   "merging the Geometric Mean of all markets");
+	engine.stop();
+	expect(london.getTrades("SIE").size() == 1 && frankfurt.getTrades("SIE").size() == 1,
+		   "adding the trades of a dual listed symbol to their market");
+	
+	// Restarted with a new stock, the symbols are routed once again
+	addTestStock(frankfurt, "SAP");
+	engine.start();
+	bool restarted = engine.numListings("SIE") == 2 && engine.numListings("SAP") == 1 &&
+					 pushTrade(engine, INVALID_MARKET, "SAP", 50, 1);
+	engine.computeAll();
+	engine.stop();
+	expect(restarted && first != second && frankfurt.getTrades("SAP").size() == 1 && engine.numTradedStocks() == 5,
+		   "restarting the engine");
+}
+
+void Tester::checkOrderBook()
+{
+	const time_t base = 1500000000;
+	
+	// Price then time priority, the last resting order partially filled.
+	// Each execution is a trade at the resting price, on the incoming side
+	{
+		StockMarket market;
+		SymbolId    id = addTestStock(market, "AAA");
+		OrderBook   book(market, "AAA");
+		OrderStatus first  = book.addOrder(false, 100, 5, base);
+		OrderStatus second = book.addOrder(false, 100, 5, base + 1);
+		book.addOrder(false, 99, 5, base + 2);
+		OrderStatus buy = book.addOrder(true, 100, 12, base + 3);
+		TradesView  trades = market.getTrades(id);
+		expect(buy.filled == 12 && buy.resting == 0 && buy.numTrades == 3 && buy.id == INVALID_ORDER &&
+			   book.bestAsk() == 100 && book.quantityAt(100) == 3 && book.numOrders() == 1, "price and time priority");
+		expect(trades.size() == 3 &&
+			   trades.price(0) == 99  && trades.quantity(0) == 5 && trades.buying(0) &&
+			   trades.price(1) == 100 && trades.quantity(1) == 5 && trades.buying(1) &&
+			   trades.price(2) == 100 && trades.quantity(2) == 2 && trades.buying(2) &&
+			   market.findStock(id)->lastPrice() == 100, "executions added as trades");
+		expect(!book.cancel(first.id) && book.cancel(second.id) && book.bestAsk() == 0 && book.numOrders() == 0,
+			   "cancelling the partially filled order only");
+		
+		// An incoming order partially filled rests the remaining quantity
+		book.addOrder(false, 101, 4, base + 4);
+		OrderStatus partial = book.addOrder(true, 101, 10, base + 5);
+		expect(partial.filled == 4 && partial.resting == 6 && partial.id != INVALID_ORDER &&
+			   book.bestBid() == 101 && book.bestAsk() == 0 && book.quantityAt(101) == 6, "resting a partially filled order");
+	}
+	
+	// A sweep clearing the other side rests at its limit, later orders
+	// match it at its price
+	{
+		StockMarket market;
+		SymbolId    id = addTestStock(market, "AAA");
+		OrderBook   book(market, "AAA");
+		book.addOrder(false, 101, 2, base);
+		book.addOrder(false, 102, 3, base + 1);
+		OrderStatus sweep = book.addOrder(true, 105, 10, base + 2);
+		expect(sweep.filled == 5 && sweep.resting == 5 && sweep.numTrades == 2 &&
+			   book.bestBid() == 105 && book.bestAsk() == 0 && book.numOrders() == 1, "resting after a sweep");
+		OrderStatus sell = book.addOrder(false, 104, 2, base + 3);
+		TradesView  trades = market.getTrades(id);
+		expect(sell.filled == 2 && sell.resting == 0 && trades.size() == 3 &&
+			   trades.price(2) == 105 && !trades.buying(2) && book.quantityAt(105) == 3, "matching the order rested by a sweep");
+	}
+	
+	// The best price moves to the next level holding orders when the best
+	// level empties, by execution or by cancel
+	{
+		StockMarket market;
+		addTestStock(market, "AAA");
+		OrderBook   book(market, "AAA");
+		book.addOrder(true, 90, 1, base);
+		book.addOrder(true, 95, 1, base);
+		OrderStatus bid = book.addOrder(true, 97, 1, base);
+		book.addOrder(false, 110, 1, base);
+		OrderStatus ask = book.addOrder(false, 112, 1, base);
+		book.addOrder(false, 115, 1, base);
+		book.cancel(bid.id);
+		bool bids = book.bestBid() == 95;
+		book.addOrder(false, 95, 1, base + 1);
+		bids = bids && book.bestBid() == 90;
+		book.addOrder(true, 110, 1, base + 2);
+		bool asks = book.bestAsk() == 112;
+		book.cancel(ask.id);
+		asks = asks && book.bestAsk() == 115;
+		expect(bids, "next best bid when the best level empties");
+		expect(asks, "next best ask when the best level empties");
+	}
+	
+	// Cancels of unknown identifiers, including the identifier of a
+	// cancelled order whose node was reused by a newer order
+	{
+		StockMarket market;
+		addTestStock(market, "AAA");
+		OrderBook   book(market, "AAA");
+		OrderStatus old = book.addOrder(true, 100, 1, base);
+		bool cancelled = book.cancel(old.id);
+		OrderStatus reused = book.addOrder(true, 100, 2, base + 1);
+		expect(cancelled && !book.cancel(INVALID_ORDER) && !book.cancel(old.id) &&
+			   (uint32_t) reused.id == (uint32_t) old.id && book.quantityAt(100) == 2, "refusing stale identifiers");
+		expect(book.cancel(reused.id) && !book.cancel(reused.id) && book.numOrders() == 0, "cancelling once");
+	}
+	
+	// Orders too far from the prices of the book are refused
+	{
+		StockMarket market;
+		addTestStock(market, "AAA");
+		OrderBook   book(market, "AAA");
+		OrderBook   unknown(market, "ALE");
+		book.addOrder(true, 100, 1, base);
+		OrderStatus far = book.addOrder(false, 100 + (int) OrderBook::MAX_PRICE_LEVELS, 1, base);
+		OrderStatus edge = book.addOrder(false, (int) OrderBook::MAX_PRICE_LEVELS, 1, base);
+		OrderStatus none = unknown.addOrder(true, 100, 1, base);
+		expect(far.id == INVALID_ORDER && far.filled == 0 && far.resting == 0 &&
+			   edge.id != INVALID_ORDER && book.numOrders() == 2, "refusing prices beyond MAX_PRICE_LEVELS");
+		expect(!unknown.valid() && none.id == INVALID_ORDER && none.filled == 0, "refusing orders of an unknown stock");
+	}
+}
+
+void Tester::checkIngestion()
+{
+	const time_t base = 1500000000;
+	
+	// A symbol too long for a record is still listed, its trades go by identifier
+	{
+		StockMarket market;
+		SymbolId    id = addTestStock(market, "VERYLONGSYMBOLNAME");
+		TradeRecord records[2];
+		bool        refused = !setTradeRecord(records[0], "VERYLONGSYMBOLNAME", 10, 1, true, base) &&
+							  records[0].symbol[0] == '\0';
+		setTradeRecord(records[1], "", 20, 1, true, base, id);
+		expect(id != INVALID_SYMBOL && refused && market.addTrades(TradeSpan(records, 2)) == 1 &&
+			   market.getTrades(id).size() == 1, "listing a symbol longer than a trade record");
+	}
+	
+	// Queue: capacity rounded to a power of 2, values taken in order
+	{
+		MpscQueue<int> queue(5);
+		bool           pushed = true;
+		for (int i = 0; i < 8; ++i) {
+			pushed = pushed && queue.tryPush(i);
+		}
+		bool full = !queue.tryPush(8) && queue.size() == 8;
+		int  values[8];
+		bool taken = queue.popBatch(values, 3) == 3 && values[0] == 0 && values[2] == 2 &&
+					 queue.tryPush(8) && queue.popBatch(values, 8) == 6;
+		int  value = 0;
+		expect(queue.capacity() == 8 && pushed && full && taken && values[0] == 3 && values[5] == 8 &&
+			   !queue.tryPop(value), "filling and emptying the ingestion queue");
+	}
+	
+	// Many producers: no value lost or duplicated, each producer in order
+	{
+		const int              numProducers = 4;
+		const int              numValues    = 20000;
+		MpscQueue<int>         queue(64);
+		vector<thread>         producers;
+		for (int p = 0; p < numProducers; ++p) {
+			producers.push_back(thread([&queue, p, numValues]() {
+				for (int i = 0; i < numValues; ++i) {
+					while (!queue.tryPush(p * numValues + i)) {
+						this_thread::yield();
+					}
+				}
+			}));
+		}
+		vector<int> next(numProducers, 0);
+		bool        ordered = true;
+		int         value   = 0;
+		for (int count = 0; count < numProducers * numValues; ) {
+			if (queue.tryPop(value)) {
+				int p   = value / numValues;
+				ordered = ordered && value % numValues == next[p]++;
+				count++;
+			}
+		}
+		for (size_t p = 0; p < producers.size(); ++p) {
+			producers[p].join();
+		}
+		expect(ordered && !queue.tryPop(value), "pushing to the ingestion queue from many threads");
+	}
+	
+	// Dropping the newest trades of a full queue, before the consumer runs
+	{
+		StockMarket   market;
+		addTestStock(market, "AAA");
+		TradeIngestor ingestor(market, BACKPRESSURE_DROP_NEWEST, 4);
+		TradeRecord   record;
+		size_t        accepted = 0;
+		for (int i = 0; i < 6; ++i) {
+			setTradeRecord(record, i == 0 ? "ZZZ" : "AAA", 10 + i, 1, true, base + i);
+			accepted += ingestor.push(record) ? 1 : 0;
+		}
+		IngestStats queued  = ingestor.stats();
+		size_t      drained = ingestor.drain();
+		IngestStats stats   = ingestor.stats();
+		expect(accepted == 4 && queued.queueDepth == 4 && queued.dropped == 2 && drained == 4 &&
+			   stats.applied == 3 && stats.rejected == 1 && market.getTrades("AAA").size() == 3,
+			   "dropping the newest trades of a full ingestion queue");
+	}
+	
+	// Blocking and spinning producers wait for the consumer thread
+	BackpressurePolicy policies[] = { BACKPRESSURE_BLOCK, BACKPRESSURE_SPIN };
+	for (size_t k = 0; k < 2; ++k) {
+		const int      numProducers = 4;
+		const int      numTrades    = 2000;
+		StockMarket    market;
+		SymbolId       id = addTestStock(market, "AAA");
+		TradeIngestor  ingestor(market, policies[k], 8, 4);
+		vector<thread> producers;
+		atomic<int>    accepted(0);
+		ingestor.start();
+		for (int p = 0; p < numProducers; ++p) {
+			producers.push_back(thread([&ingestor, &accepted, id, base, numTrades]() {
+				TradeRecord record;
+				for (int i = 0; i < numTrades; ++i) {
+					setTradeRecord(record, "", 10, 1, true, base + i, id);
+					accepted += ingestor.push(record) ? 1 : 0;
+				}
+			}));
+		}
+		for (size_t p = 0; p < producers.size(); ++p) {
+			producers[p].join();
+		}
+		ingestor.stop();
+		market.flushTrades();
+		IngestStats stats = ingestor.stats();
+		expect(accepted == numProducers * numTrades && stats.dropped == 0 &&
+			   stats.applied == (size_t) (numProducers * numTrades) &&
+			   market.getTrades(id).size() == (size_t) (numProducers * numTrades),
+			   k == 0 ? "blocking producers on a full ingestion queue" : "spinning producers on a full ingestion queue");
+	}
+}
+
+void Tester::checkPersistence()
+{
+	const time_t base = 1500000000;
+	
+	// Journal: stocks and trades appended as added, late trades included
+	{
+		const char*    path = "checkJournal.jnl";
+		StockMarket    market;
+		TradeJournal   journal;
+		PreferredStock preferred("GIN", 8, 100, 2);
+		remove(path);
+		bool opened = journal.open(path);
+		market.setJournal(&journal);
+		SymbolId common = addTestStock(market, "TEA");
+		market.addStock(&preferred);
+		for (int i = 0; i < 500; ++i) {
+			market.addTrade(common,                 100 + i % 9, 1 + i % 4, i % 3 == 0, base + (i % 10 == 9 ? i - 50 : i));
+			market.addTrade(market.symbolId("GIN"), 200 + i % 5, 2,         i % 2 == 0, base + i);
+		}
+		market.setJournal(NULL);
+		StockMarket replayed;
+		size_t      numRecords = journal.replay(replayed);
+		const PreferredStock* stock = dynamic_cast<const PreferredStock*>(replayed.findStock("GIN"));
+		expect(opened && numRecords == 1002 && journal.numRecords() == 1002, "journal recording each stock and trade");
+		expect(stock && stock->fixedDividend() == 2 && stock->lastPrice() == market.findStock("GIN")->lastPrice() &&
+			   replayed.stocks().size() == 2, "journal replaying the stocks");
+		expect(sameTrades(market, replayed, "TEA") && sameTrades(market, replayed, "GIN"), "journal replaying the trades");
+		journal.close();
+		remove(path);
+	}
+	
+	// Snapshot: stocks, computed values and trades loaded as saved
+	{
+		const char* path = "checkSnapshot.snp";
+		StockMarket market("FTSE100", "London", "UK");
+		SymbolId    first  = addTestStock(market, "TEA");
+		SymbolId    second = addTestStock(market, "POP");
+		market.clock().setMode(CLOCK_EVENT);
+		for (int i = 0; i < 3000; ++i) {
+			market.addTrade(i % 4 ? first : second, 100 + i % 11, 1 + i % 3, true, base + (i % 7 == 6 ? i - 20 : i));
+		}
+		market.computeStockValues();
+		bool        saved = market.saveSnapshot(path);
+		StockMarket loaded;
+		bool        load  = loaded.loadSnapshot(path);
+		expect(saved && load && strcmp(loaded.getName(), "FTSE100") == 0 && strcmp(loaded.getCountry(), "UK") == 0 &&
+			   loaded.stocks().size() == 2, "snapshot loading the stock market");
+		expect(sameTrades(market, loaded, "TEA") && sameTrades(market, loaded, "POP"), "snapshot loading the trades");
+		expect(loaded.findStock("TEA")->weightedStockPrice() == market.findStock("TEA")->weightedStockPrice() &&
+			   loaded.geometricMean() == market.geometricMean() && market.geometricMean() > 0 &&
+			   loaded.vwap("POP", base, base + 3000) == market.vwap("POP", base, base + 3000),
+			   "snapshot loading the computed values");
+		remove(path);
+	}
+}
+
+void Tester::checkTradeLoader()
+{
+	// Header by its field names, comments and CRLF line ends, every side spelling
+	{
+		StockMarket market;
+		SymbolId    id = addTestStock(market, "AAA");
+		TradeLoader loader(market);
+		const char  csv[] = "# trades\n"
+							"Symbol,Price,Quantity,Side,Timestamp\r\n"
+							"AAA,10,1,B,1500000000\n"
+							"AAA,11,2,buy,1500000001\r\n"
+							"AAA,12,3,s,1500000002\n"
+							"AAA,13,4,SeLL,1500000003";
+		loader.loadCsv(csv, sizeof(csv) - 1);
+		LoadStats  stats  = loader.stats();
+		TradesView trades = market.getTrades(id);
+		expect(stats.rows == 4 && stats.parseErrors == 0 && stats.loaded == 4 && stats.bytes == sizeof(csv) - 1,
+			   "loader skipping the header and the comments");
+		expect(trades.size() == 4 && trades.buying(0) && trades.buying(1) && !trades.buying(2) && !trades.buying(3) &&
+			   trades.price(3) == 13 && trades.quantity(3) == 4 && trades.timestamp(3) == 1500000003,
+			   "loader parsing the fields and the side");
+	}
+	
+	// Malformed rows are counted and skipped, the others loaded.
+	// A first row with an unparsable price is a malformed row, not a header
+	{
+		StockMarket market;
+		addTestStock(market, "AAA");
+		TradeLoader loader(market);
+		const char  csv[] = "AAA,x10,1,B,1500000000\n"
+							"AAA,10,1,B\n"
+							"AAA,10,1,B,1500000000,1\n"
+							",10,1,B,1500000000\n"
+							"AAAAAAAAAAAAAAAA,10,1,B,1500000000\n"
+							"AAA,10,1,BU,1500000000\n"
+							"AAA,10,1,,1500000000\n"
+							"AAA,10,99999999999,B,1500000000\n"
+							"AAA,10,1,B,15000x0000\n"
+							"SYMBOL,PRICE,QUANTITY,SIDE,TIMESTAMP\n"
+							"BBB,10,1,B,1500000000\n"
+							"AAA,-10,1,S,1500000001\n";
+		loader.loadCsv(csv, sizeof(csv) - 1);
+		LoadStats stats = loader.stats();
+		expect(stats.rows == 12 && stats.parseErrors == 10, "loader counting the malformed rows");
+		expect(stats.loaded == 1 && stats.rejected == 1 && market.getTrades("AAA").price(0) == -10, "loader handing the parsed rows to the market");
+	}
+}
+
+void Tester::checkWindowKernels()
+{
+	// Random columns, sorted or not, of every length up to several vector
+	// steps and from any offset, so each tail and misaligned start is summed.
+	// Windows bounded by the timestamps of the columns, empty or inverted
+	const size_t   maxCount = 67;
+	mt19937        generator(12345);
+	vector<time_t> timestamps(maxCount + 3);
+	vector<int>    prices    (maxCount + 3);
+	vector<int>    quantities(maxCount + 3);
+	bool           same    = true;
+	bool           counted = true;
+	for (int round = 0; round < 40; ++round) {
+		bool sorted = round % 2 == 0;
+		for (size_t i = 0; i < timestamps.size(); ++i) {
+			timestamps[i] = 1500000000 + (sorted ? (time_t) i * 2 : (time_t) (generator() % 200));
+			prices    [i] = (int) (generator() % 2000000) - 1000;
+			quantities[i] = (int) (generator() % 100000);
+		}
+		for (size_t offset = 0; offset < 3; ++offset) {
+			for (size_t count = 0; count <= maxCount; ++count) {
+				const time_t* columns = &timestamps[offset];
+				time_t        bounds[][2] = {
+					{ 0,                                  1600000000 },
+					{ columns[0],                         columns[count ? count - 1 : 0] },
+					{ columns[count / 3],                 columns[count / 3] },
+					{ columns[count / 2] + 1,             columns[count / 4] },
+					{ 1500000000 + (time_t) count,        1500000000 + (time_t) count + 30 },
+					{ 1600000000,                         1700000000 }
+				};
+				for (size_t k = 0; k < sizeof(bounds) / sizeof(bounds[0]); ++k) {
+					WindowSums kernel;
+					WindowSums scalar;
+					windowSums      (columns, &prices[offset], &quantities[offset], count, bounds[k][0], bounds[k][1], kernel);
+					windowSumsScalar(columns, &prices[offset], &quantities[offset], count, bounds[k][0], bounds[k][1], scalar);
+					same = same && kernel.priceQuantity == scalar.priceQuantity && kernel.quantity == scalar.quantity;
+					if (k == 0) {
+						int64_t quantity = 0;
+						for (size_t i = 0; i < count; ++i) {
+							quantity += quantities[offset + i];
+						}
+						counted = counted && scalar.quantity == quantity;
+					}
+				}
+			}
+		}
+	}
+	expect(counted, "scalar kernel summing all trades of a window");
+	expect(same, string("window kernel ").append(windowKernelName()).append(" matching the scalar kernel").c_str());
+}
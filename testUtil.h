@@ -8,9 +8,15 @@ class StockMarket;
 class Tester
 {
 	public:
+		Tester();
+		
 		void addStockData       (StockMarket& stockMarket);
 		void check              (StockMarket& stockMarket);
 		
+		//! Check the components the stock market is built on, on markets
+		//! of their own, and print the number of checks passing and failing
+		void checkComponents    ();
+		
 	private:
 	//! For each given stock symbol, check if stock object exists and
 	//! check these values: Last dividend,  Par Value, Last price,
@@ -24,6 +30,45 @@ class Tester
 						double       PERatio,
 						double       vwap,
 						StockMarket& stockMarket);
+		
+		//! Count a check, print its name if it fails
+		void expect(bool condition, const char* name);
+		
+		//! Rolling VWAP window with late and future trades
+		void checkVwapWindow    ();
+		
+		//! Expiry of the trades, and of the bars with them
+		void checkRetention     ();
+		
+		//! Published versions read while the writer goes on
+		void checkReadSnapshot  ();
+		
+		//! Late trades merged at their place in time and in the running sums
+		void checkLateTrades    ();
+		
+		//! Delivery of the stock changes to the subscriptions
+		void checkNotifications ();
+		
+		//! Routing and merged values of markets run side by side
+		void checkExchangeEngine();
+		
+		//! Matching of the limit orders of a stock and the trades it adds
+		void checkOrderBook     ();
+		
+		//! Trade records pushed to a stock market
+		void checkIngestion     ();
+		
+		//! Stock markets rebuilt from their journal and from their snapshot
+		void checkPersistence   ();
+		
+		//! Trade files parsed by the bulk loader
+		void checkTradeLoader   ();
+		
+		//! Window sums of the kernel in use against the scalar kernel
+		void checkWindowKernels ();
+		
+		int _numPasses;   // checks of 'checkComponents'
+		int _numFails;
 };
 
 #endif
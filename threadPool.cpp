@@ -0,0 +1,92 @@
+#include "threadPool.h"
+
+using namespace std;
+
+ThreadPool::ThreadPool(size_t numWorkers) :
+			_workers   (),
+			_lock      (),
+			_wakeUp    (),
+			_finished  (),
+			_task      (NULL),
+			_numTasks  (0),
+			_nextTask  (0),
+			_generation(0),
+			_busy      (0),
+			_stopping  (false)
+{
+	for (size_t i = 0; i < numWorkers; ++i) {
+		_workers.push_back(thread(&ThreadPool::run, this));
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		lock_guard<mutex> guard(_lock);
+		_stopping = true;
+	}
+	_wakeUp.notify_all();
+	for (auto& worker : _workers) {
+		worker.join();
+	}
+}
+
+size_t ThreadPool::defaultWorkers()
+{
+	unsigned int hardware = thread::hardware_concurrency();
+	return hardware > 1 ? hardware - 1 : 0;
+}
+
+void ThreadPool::runTasks()
+{
+	size_t index;
+	while ((index = _nextTask.fetch_add(1)) < _numTasks) {
+		(*_task)(index);
+	}
+}
+
+void ThreadPool::run()
+{
+	size_t generation = 0;
+	unique_lock<mutex> lock(_lock);
+	for (;;) {
+		_wakeUp.wait(lock, [&] { return _stopping || _generation != generation; });
+		if (_stopping) {
+			return;
+		}
+		generation = _generation;
+		_busy++;
+		lock.unlock();
+		runTasks();
+		lock.lock();
+		if (--_busy == 0) {
+			_finished.notify_all();
+		}
+	}
+}
+
+void ThreadPool::parallelFor(size_t numTasks, Task const& task)
+{
+	if (_workers.empty() || numTasks <= 1) {
+		for (size_t i = 0; i < numTasks; ++i) {
+			task(i);
+		}
+		return;
+	}
+	{
+		// Workers waking up late for the previous job must be done with it
+		unique_lock<mutex> lock(_lock);
+		_finished.wait(lock, [&] { return _busy == 0; });
+		_task     = &task;
+		_numTasks = numTasks;
+		_nextTask.store(0);
+		_generation++;
+	}
+	_wakeUp.notify_all();
+	runTasks();
+	
+	// Wait for the workers still running a task of this job
+	unique_lock<mutex> lock(_lock);
+	_finished.wait(lock, [&] { return _busy == 0; });
+	_task = NULL;
+}
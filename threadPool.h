@@ -0,0 +1,54 @@
+#ifndef _THREAD_POOL_H
+#define _THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//! Fixed size pool of worker threads running indexed tasks.
+//! The calling thread takes part in the work, so a pool of 0 worker
+//! runs everything serially on the caller.
+class ThreadPool
+{
+	public:
+		typedef std::function<void(size_t)> Task;
+		
+		//! Create 'numWorkers' threads, by default one less than the hardware threads
+		ThreadPool(size_t numWorkers = defaultWorkers());
+		~ThreadPool();
+		
+		//! Accessing
+		size_t numWorkers() const { return _workers.size(); }
+		
+		//! Run task(0) ... task(numTasks - 1) over the pool and return when all are done.
+		//! Tasks are picked in any order by any thread.
+		//! NOTE: must not be called concurrently nor from a task
+		void parallelFor(size_t numTasks, Task const& task);
+		
+		static size_t defaultWorkers();
+		
+	private:
+		void run();
+		void runTasks();
+		
+		std::vector<std::thread> _workers;
+		std::mutex               _lock;
+		std::condition_variable  _wakeUp;    // new job or shutdown
+		std::condition_variable  _finished;  // all workers left the current job
+		const Task*              _task;
+		size_t                   _numTasks;
+		std::atomic<size_t>      _nextTask;
+		size_t                   _generation;  // incremented for each job
+		size_t                   _busy;        // workers inside the current job
+		bool                     _stopping;
+		
+	//! Disable copy constructor and 
+	//! copy assignment operator
+	ThreadPool(const ThreadPool&);
+	ThreadPool& operator=(const ThreadPool&);
+};
+
+#endif
@@ -0,0 +1,130 @@
+#include "tradeIngestor.h"
+#include "stockMarket.h"
+#include <chrono>
+
+using namespace std;
+
+TradeIngestor::TradeIngestor(StockMarket&       market,
+							 BackpressurePolicy policy,
+							 size_t             capacity,
+							 size_t             batchSize) :
+							_market        (market),
+							_policy        (policy),
+							_queue         (capacity),
+							_batch         (batchSize ? batchSize : 1),
+							_consumer      (),
+							_running       (false),
+							_spaceLock     (),
+							_spaceAvailable(),
+							_waiters       (0),
+							_pushed        (0),
+							_dropped       (0),
+							_applied       (0),
+							_rejected      (0),
+							_batches       (0)
+							{}
+
+TradeIngestor::~TradeIngestor()
+{
+	stop();
+}
+
+bool TradeIngestor::push(TradeRecord const& record)
+{
+	if (_queue.tryPush(record)) {
+		_pushed.fetch_add(1, memory_order_relaxed);
+		return true;
+	}
+	
+	switch (_policy) {
+		case BACKPRESSURE_DROP_NEWEST:
+			_dropped.fetch_add(1, memory_order_relaxed);
+			return false;
+			
+		case BACKPRESSURE_SPIN:
+			while (!_queue.tryPush(record)) {
+			}
+			break;
+			
+		case BACKPRESSURE_BLOCK:
+		default: {
+			unique_lock<mutex> lock(_spaceLock);
+			_waiters.fetch_add(1);
+			while (!_queue.tryPush(record)) {
+				// Timed wait: the consumer only notifies when it sees waiters
+				_spaceAvailable.wait_for(lock, chrono::milliseconds(1));
+			}
+			_waiters.fetch_sub(1);
+			break;
+		}
+	}
+	_pushed.fetch_add(1, memory_order_relaxed);
+	return true;
+}
+
+size_t TradeIngestor::applyBatch()
+{
+	size_t count = _queue.popBatch(&_batch[0], _batch.size());
+	if (count > 0) {
+		if (_waiters.load() > 0) {
+			lock_guard<mutex> lock(_spaceLock);
+			_spaceAvailable.notify_all();
+		}
+		size_t added = _market.addTrades(TradeSpan(&_batch[0], count));
+		_applied .fetch_add(added,         memory_order_relaxed);
+		_rejected.fetch_add(count - added, memory_order_relaxed);
+		_batches .fetch_add(1,             memory_order_relaxed);
+	}
+	return count;
+}
+
+size_t TradeIngestor::drain()
+{
+	size_t result = 0;
+	size_t count  = 0;
+	while ((count = applyBatch()) > 0) {
+		result += count;
+	}
+	return result;
+}
+
+void TradeIngestor::run()
+{
+	int idle = 0;
+	while (_running.load(memory_order_acquire)) {
+		if (applyBatch() > 0) {
+			idle = 0;
+		} else if (++idle < 64) {
+			this_thread::yield();
+		} else {
+			this_thread::sleep_for(chrono::microseconds(50));
+		}
+	}
+	drain();
+}
+
+void TradeIngestor::start()
+{
+	if (!_running.exchange(true)) {
+		_consumer = thread(&TradeIngestor::run, this);
+	}
+}
+
+void TradeIngestor::stop()
+{
+	if (_running.exchange(false)) {
+		_consumer.join();
+	}
+}
+
+IngestStats TradeIngestor::stats() const
+{
+	IngestStats result;
+	result.queueDepth = _queue.size();
+	result.pushed     = _pushed  .load(memory_order_relaxed);
+	result.dropped    = _dropped .load(memory_order_relaxed);
+	result.applied    = _applied .load(memory_order_relaxed);
+	result.rejected   = _rejected.load(memory_order_relaxed);
+	result.batches    = _batches .load(memory_order_relaxed);
+	return result;
+}
@@ -0,0 +1,104 @@
+#ifndef _TRADE_INGESTOR_H
+#define _TRADE_INGESTOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "mpscQueue.h"
+#include "tradeRecord.h"
+
+class StockMarket;
+
+//! What a producer does when the ingestion queue is full.
+//! NOTE: blocking and spinning wait for another thread to make room, through
+//! 'start' or 'poll'. Before the consumer runs, a producer filling the queue
+//! waits forever: push less than the capacity, or drop the newest trades
+enum BackpressurePolicy
+{
+	BACKPRESSURE_BLOCK,        // sleep until the consumer makes room
+	BACKPRESSURE_DROP_NEWEST,  // drop the trade being pushed
+	BACKPRESSURE_SPIN          // busy wait until the consumer makes room
+};
+
+//! Ingestion counters
+struct IngestStats
+{
+	size_t queueDepth;  // approximate number of trades waiting in the queue
+	size_t pushed;      // trades accepted by the queue
+	size_t dropped;     // trades dropped because the queue was full
+	size_t applied;     // trades added to the stock market
+	size_t rejected;    // trades refused by the stock market (unregistered stock)
+	size_t batches;     // number of batches applied
+};
+
+//! Lock-free ingestion front end of a stock market.
+//! Feed handlers push trade records from any thread into a
+//! multi-producer / single-consumer queue, a consumer thread drains it
+//! in batches through 'StockMarket::addTrades'.
+//! NOTE: while the consumer runs, it is the only thread allowed
+//! to modify the stock market
+class TradeIngestor
+{
+	public:
+		static const size_t DEFAULT_CAPACITY   = 1 << 16;
+		static const size_t DEFAULT_BATCH_SIZE = 1024;
+		
+		TradeIngestor(StockMarket&       market,
+					  BackpressurePolicy policy    = BACKPRESSURE_BLOCK,
+					  size_t             capacity  = DEFAULT_CAPACITY,
+					  size_t             batchSize = DEFAULT_BATCH_SIZE);
+		~TradeIngestor();
+		
+		//! Accessing
+		BackpressurePolicy policy() const { return _policy; }
+		IngestStats        stats () const;
+		
+		//! Push a trade, safe to call from many threads at once.
+		//! Returns false if the trade was dropped. On a full queue, waits
+		//! for the consumer unless the policy drops the trade, see above
+		bool push(TradeRecord const& record);
+		
+		//! Start and stop the consumer thread.
+		//! Trades still queued when stopping are applied before returning
+		void start();
+		void stop();
+		
+		//! Apply all queued trades from the calling thread, when the
+		//! consumer thread is not running. Returns the number of trades applied
+		size_t drain();
+		
+		//! Same as above for one batch at most, for a thread doing other work
+		//! between the batches. Returns the number of trades taken from the queue
+		size_t poll() { return applyBatch(); }
+		
+	private:
+		void   run();
+		size_t applyBatch();
+		
+		StockMarket&             _market;
+		BackpressurePolicy       _policy;
+		MpscQueue<TradeRecord>   _queue;
+		std::vector<TradeRecord> _batch;  // only used by the consumer
+		std::thread              _consumer;
+		std::atomic<bool>        _running;
+		
+		// Producers blocked on a full queue wait on this condition
+		std::mutex               _spaceLock;
+		std::condition_variable  _spaceAvailable;
+		std::atomic<int>         _waiters;
+		
+		std::atomic<size_t>      _pushed;
+		std::atomic<size_t>      _dropped;
+		std::atomic<size_t>      _applied;
+		std::atomic<size_t>      _rejected;
+		std::atomic<size_t>      _batches;
+		
+	//! Disable copy constructor and 
+	//! copy assignment operator
+	TradeIngestor(const TradeIngestor&);
+	TradeIngestor& operator=(const TradeIngestor&);
+};
+
+#endif
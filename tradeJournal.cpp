@@ -0,0 +1,268 @@
+#include "tradeJournal.h"
+#include "stockMarket.h"
+#include <iostream>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+static const char     JOURNAL_MAGIC[8] = { 'S', 'S', 'M', 'J', 'R', 'N', 'L', '\0' };
+static const uint32_t JOURNAL_VERSION  = 1;
+
+const size_t TradeJournal::DEFAULT_BATCH_SIZE;
+
+//! Header at the beginning of the journal file
+struct TradeJournal::Header
+{
+	char     magic[8];
+	uint32_t version;
+	uint32_t recordSize;
+	uint64_t numRecords;  // records committed, updated after each record is written
+	char     reserved[40];
+};
+
+TradeJournal::TradeJournal() :
+			_fd         (-1),
+			_base       (NULL),
+			_capacity   (0),
+			_mappedBytes(0),
+			_options    (),
+			_unsynced   (0)
+			{}
+
+TradeJournal::~TradeJournal()
+{
+	close();
+}
+
+TradeJournal::Header* TradeJournal::header() const
+{
+	return reinterpret_cast<Header*>(_base);
+}
+
+size_t TradeJournal::numRecords() const
+{
+	return _base ? (size_t) header()->numRecords : 0;
+}
+
+JournalRecord* TradeJournal::records() const
+{
+	return reinterpret_cast<JournalRecord*>(_base + sizeof(Header));
+}
+
+JournalRecord const& TradeJournal::record(size_t i) const
+{
+	return records()[i];
+}
+
+bool TradeJournal::map(size_t capacity)
+{
+	size_t bytes = sizeof(Header) + capacity * sizeof(JournalRecord);
+	struct stat status;
+	if (fstat(_fd, &status) != 0) {
+		return false;
+	}
+	if ((size_t) status.st_size < bytes && ftruncate(_fd, (off_t) bytes) != 0) {
+		return false;
+	}
+	if (_base) {
+		munmap(_base, _mappedBytes);
+		_base = NULL;
+	}
+	void* base = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+	if (base == MAP_FAILED) {
+		return false;
+	}
+	_base        = static_cast<char*>(base);
+	_capacity    = capacity;
+	_mappedBytes = bytes;
+	return true;
+}
+
+bool TradeJournal::open(const char* path, JournalOptions const& options)
+{
+	close();
+	_options = options;
+	_fd = ::open(path, O_RDWR | O_CREAT, 0644);
+	if (_fd < 0) {
+		cout << "Cannot open journal '" << path << "'" << endl;
+		return false;
+	}
+	
+	bool        result = false;
+	struct stat status;
+	if (fstat(_fd, &status) == 0) {
+		if (status.st_size == 0) {
+			// New journal
+			size_t capacity = _options.initialCapacity ? _options.initialCapacity : 1;
+			if (map(capacity)) {
+				Header* h = header();
+				memcpy(h->magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+				h->version    = JOURNAL_VERSION;
+				h->recordSize = sizeof(JournalRecord);
+				h->numRecords = 0;
+				result = true;
+			}
+		} else if ((size_t) status.st_size >= sizeof(Header)) {
+			// Existing journal: map the whole file
+			size_t capacity = ((size_t) status.st_size - sizeof(Header)) / sizeof(JournalRecord);
+			if (map(capacity)) {
+				Header* h = header();
+				result = memcmp(h->magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) == 0 &&
+						 h->version    == JOURNAL_VERSION &&
+						 h->recordSize == sizeof(JournalRecord) &&
+						 h->numRecords <= capacity;
+			}
+		}
+	}
+	if (!result) {
+		cout << "Invalid journal '" << path << "'" << endl;
+		close();
+	}
+	return result;
+}
+
+void TradeJournal::close()
+{
+	if (_base) {
+		sync();
+		munmap(_base, _mappedBytes);
+		_base = NULL;
+	}
+	if (_fd >= 0) {
+		::close(_fd);
+		_fd = -1;
+	}
+	_capacity    = 0;
+	_mappedBytes = 0;
+	_unsynced    = 0;
+}
+
+void TradeJournal::sync()
+{
+	if (_base) {
+		msync(_base, sizeof(Header) + numRecords() * sizeof(JournalRecord), MS_SYNC);
+		_unsynced = 0;
+	}
+}
+
+bool TradeJournal::reserve()
+{
+	return _base && (numRecords() < _capacity || map(2 * _capacity));
+}
+
+void TradeJournal::committed()
+{
+	header()->numRecords++;
+	if (_options.syncEvery > 0 && ++_unsynced >= _options.syncEvery) {
+		sync();
+	}
+}
+
+bool TradeJournal::appendStock(const Stock* stock)
+{
+	if (!stock || stock->symbol().size() > MAX_SYMBOL_LENGTH || !reserve()) {
+		return false;
+	}
+	JournalRecord& r = records()[numRecords()];
+	memset(&r, 0, sizeof(r));
+	const PreferredStock* preferred = dynamic_cast<const PreferredStock*>(stock);
+	r.kind          = preferred ? JOURNAL_PREFERRED_STOCK : JOURNAL_STOCK;
+	r.price         = stock->lastDividend();
+	r.quantity      = stock->parValue();
+	r.fixedDividend = preferred ? preferred->fixedDividend() : 0;
+	r.lastPrice     = stock->lastPrice();
+	memcpy(r.symbol, stock->symbol().c_str(), stock->symbol().size());
+	committed();
+	return true;
+}
+
+bool TradeJournal::appendTrade(const char* symbol,
+							   int         price,
+							   int         quantity,
+							   bool        buy,
+							   time_t      timestamp)
+{
+	size_t length = symbol ? strnlen(symbol, MAX_SYMBOL_LENGTH + 1) : 0;
+	if (length == 0 || length > MAX_SYMBOL_LENGTH || !reserve()) {
+		return false;
+	}
+	JournalRecord& r = records()[numRecords()];
+	memset(&r, 0, sizeof(r));
+	r.kind      = JOURNAL_TRADE;
+	r.buy       = buy ? 1 : 0;
+	r.price     = price;
+	r.quantity  = quantity;
+	r.timestamp = timestamp;
+	memcpy(r.symbol, symbol, length);
+	committed();
+	return true;
+}
+
+size_t TradeJournal::visit(JournalVisitor& visitor, size_t batchSize) const
+{
+	if (batchSize == 0) {
+		batchSize = 1;
+	}
+	vector<TradeRecord> batch(batchSize);
+	size_t              count  = 0;  // trades in the batch
+	size_t              result = 0;
+	for (size_t i = 0, n = numRecords(); i < n; ++i) {
+		JournalRecord const& r = record(i);
+		if (r.kind == JOURNAL_TRADE) {
+			TradeRecord& trade = batch[count++];
+			memcpy(trade.symbol, r.symbol, MAX_SYMBOL_LENGTH);
+			trade.symbol[MAX_SYMBOL_LENGTH] = '\0';
+			trade.id        = INVALID_SYMBOL;
+			trade.price     = r.price;
+			trade.quantity  = r.quantity;
+			trade.buy       = r.buy != 0;
+			trade.timestamp = (time_t) r.timestamp;
+			if (count == batchSize) {
+				visitor.trades(TradeSpan(&batch[0], count));
+				count = 0;
+			}
+		} else {
+			// Stocks must be registered before their trades are added
+			if (count > 0) {
+				visitor.trades(TradeSpan(&batch[0], count));
+				count = 0;
+			}
+			if (r.kind == JOURNAL_PREFERRED_STOCK) {
+				PreferredStock stock(r.symbol, r.price, r.quantity, r.fixedDividend);
+				stock.lastPrice((int) r.lastPrice);
+				visitor.stock(&stock);
+			} else if (r.kind == JOURNAL_STOCK) {
+				Stock stock(r.symbol, r.price, r.quantity);
+				stock.lastPrice((int) r.lastPrice);
+				visitor.stock(&stock);
+			}
+		}
+		result++;
+	}
+	if (count > 0) {
+		visitor.trades(TradeSpan(&batch[0], count));
+	}
+	return result;
+}
+
+size_t TradeJournal::replay(StockMarket& market) const
+{
+	// Adds the decoded stocks and trades as they come
+	struct Loader : JournalVisitor {
+		Loader(StockMarket& m) : market(m) {}
+		void stock (const Stock* stock) { market.addStock(stock); }
+		void trades(TradeSpan trades)   { market.addTrades(trades); }
+		StockMarket& market;
+	};
+	
+	TradeJournal* attached = market.journal();
+	market.setJournal(NULL);
+	Loader loader(market);
+	size_t result = visit(loader);
+	market.setJournal(attached);
+	return result;
+}
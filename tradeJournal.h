@@ -0,0 +1,131 @@
+#ifndef _TRADE_JOURNAL_H
+#define _TRADE_JOURNAL_H
+
+#include <stdint.h>
+#include <cstddef>
+#include "symbolTable.h"
+#include "tradeRecord.h"
+
+// File declares the append-only journal of a stock market.
+// The journal is a memory mapped file of fixed size binary records, one per
+// stock added and one per trade added. Replaying the journal at startup
+// rebuilds the stocks and trades of a market without going through
+// 'Trade' objects.
+
+class Stock;
+class StockMarket;
+
+//! Kind of a journal record
+enum JournalRecordKind
+{
+	JOURNAL_STOCK           = 1,
+	JOURNAL_PREFERRED_STOCK = 2,
+	JOURNAL_TRADE           = 3
+};
+
+//! Fixed size journal record
+struct JournalRecord
+{
+	uint8_t  kind;
+	uint8_t  buy;
+	uint8_t  reserved[2];
+	int32_t  price;          // trade price, or stock last dividend
+	int32_t  quantity;       // trade quantity, or stock par value
+	int32_t  fixedDividend;  // preferred stocks only
+	union {
+		int64_t timestamp;   // trades
+		int64_t lastPrice;   // stocks, 0 in the journals written before it was kept
+	};
+	char     symbol[16];     // NUL terminated, MAX_SYMBOL_LENGTH characters at most
+};
+
+//! Journal options
+struct JournalOptions
+{
+	JournalOptions() : syncEvery(0), initialCapacity(1 << 16) {}
+	
+	size_t syncEvery;        // flush to disk every N records, 0 to let the system decide
+	size_t initialCapacity;  // number of records mapped when creating the file
+};
+
+//! Receiver of the records decoded by 'TradeJournal::visit'
+class JournalVisitor
+{
+	public:
+		virtual ~JournalVisitor() {}
+		
+		//! A stock record, decoded with its last price
+		virtual void stock(const Stock* stock) = 0;
+		
+		//! Consecutive trade records, in journal order
+		virtual void trades(TradeSpan trades) = 0;
+};
+
+//! Memory mapped append-only journal
+class TradeJournal
+{
+	public:
+		//! Trades decoded at once by 'visit'
+		static const size_t DEFAULT_BATCH_SIZE = 4096;
+		
+		TradeJournal();
+		~TradeJournal();
+		
+		//! Open or create a journal file.
+		//! Returns false if the file cannot be mapped or is not a journal
+		bool open(const char* path, JournalOptions const& options = JournalOptions());
+		
+		//! Flush and unmap the journal
+		void close();
+		
+		//! Accessing
+		bool   isOpen    () const { return _base != NULL; }
+		size_t numRecords() const;
+		JournalRecord const& record(size_t i) const;
+		
+		//! Append a record. Returns false if the journal cannot grow or
+		//! the symbol is longer than MAX_SYMBOL_LENGTH
+		bool appendStock(const Stock* stock);
+		bool appendTrade(const char* symbol,
+						 int         price,
+						 int         quantity,
+						 bool        buy,
+						 time_t      timestamp);
+		
+		//! Flush all records to disk
+		void sync();
+		
+		//! Decode all journal records in order. Trades are passed in batches
+		//! of at most 'batchSize' trades, never spanning a stock record so
+		//! stocks are received before their trades.
+		//! Returns the number of records decoded
+		size_t visit(JournalVisitor& visitor, size_t batchSize = DEFAULT_BATCH_SIZE) const;
+		
+		//! Rebuild the stocks and trades of a market from all journal records.
+		//! The market journal, if any, is detached while replaying.
+		//! Returns the number of records replayed
+		size_t replay(StockMarket& market) const;
+		
+	private:
+		struct Header;
+		
+		Header*        header () const;
+		JournalRecord* records() const;
+		bool    map   (size_t capacity);
+		bool    reserve();  // make room for one more record
+		void    committed();
+		
+		int            _fd;
+		char*          _base;
+		size_t         _capacity;      // records the mapping can hold
+		size_t         _mappedBytes;
+		JournalOptions _options;
+		size_t         _unsynced;      // records appended since the last sync
+		
+	//! Disable copy constructor and 
+	//! copy assignment operator
+	TradeJournal(const TradeJournal&);
+	TradeJournal& operator=(const TradeJournal&);
+};
+
+#endif
@@ -0,0 +1,258 @@
+#include "tradeLoader.h"
+#include "stockMarket.h"
+#include "diagnostics.h"
+#include <fstream>
+#include <cstring>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+static const char     PACKED_TRADES_MAGIC[8] = { 'S', 'S', 'M', 'T', 'R', 'A', 'D', '\0' };
+static const uint32_t PACKED_TRADES_VERSION  = 1;
+static const char     CSV_HEADER[]           = "SYMBOL,PRICE,QUANTITY,SIDE,TIMESTAMP";
+
+//! Parse a decimal integer in [begin, end), optionally signed.
+//! Returns false if the field is empty, not a number or does not fit
+template<typename T>
+static bool parseInteger(const char* begin, const char* end, T& value)
+{
+	bool negative = false;
+	if (begin < end && (*begin == '-' || *begin == '+')) {
+		negative = *begin == '-';
+		++begin;
+	}
+	if (begin == end || end - begin > 18) {
+		return false;
+	}
+	long long result = 0;
+	for (const char* c = begin; c < end; ++c) {
+		if (*c < '0' || *c > '9') {
+			return false;
+		}
+		result = result * 10 + (*c - '0');
+	}
+	result = negative ? -result : result;
+	value  = (T) result;
+	return (long long) value == result;
+}
+
+//! Parse the side of a trade in [begin, end), the whole field must match
+static bool parseSide(const char* begin, const char* end, bool& buy)
+{
+	size_t length = end - begin;
+	if ((length == 1 && (*begin == 'B' || *begin == 'b')) ||
+		(length == 3 && strncasecmp(begin, "BUY", 3) == 0)) {
+		buy = true;
+		return true;
+	}
+	if ((length == 1 && (*begin == 'S' || *begin == 's')) ||
+		(length == 4 && strncasecmp(begin, "SELL", 4) == 0)) {
+		buy = false;
+		return true;
+	}
+	return false;
+}
+
+//! Tell whether the line in [begin, end) is the CSV header
+static bool isCsvHeader(const char* begin, const char* end)
+{
+	size_t length = end - begin;
+	return length == sizeof(CSV_HEADER) - 1 && strncasecmp(begin, CSV_HEADER, length) == 0;
+}
+
+TradeLoader::TradeLoader(StockMarket& market, size_t batchSize) :
+			_market(market),
+			_batch (batchSize ? batchSize : 1),
+			_count (0)
+{
+	memset(&_stats, 0, sizeof(_stats));
+}
+
+void TradeLoader::flush()
+{
+	if (_count > 0) {
+		size_t added = _market.addTrades(TradeSpan(&_batch[0], _count));
+		_stats.loaded   += added;
+		_stats.rejected += _count - added;
+		_count = 0;
+	}
+}
+
+bool TradeLoader::parseCsvLine(const char* begin, const char* end)
+{
+	// Split the 5 fields
+	const char* fields[6];
+	int         numFields = 0;
+	fields[numFields++] = begin;
+	for (const char* c = begin; c < end && numFields < 6; ++c) {
+		if (*c == ',') {
+			fields[numFields++] = c + 1;
+		}
+	}
+	if (numFields != 5) {
+		return false;
+	}
+	fields[5] = end + 1;
+	
+	TradeRecord& record = _batch[_count];
+	size_t symbolLength = fields[1] - 1 - fields[0];
+	if (symbolLength == 0 || symbolLength > MAX_SYMBOL_LENGTH) {
+		return false;
+	}
+	memcpy(record.symbol, fields[0], symbolLength);
+	record.symbol[symbolLength] = '\0';
+	record.id = INVALID_SYMBOL;
+	
+	if (!parseSide   (fields[3], fields[4] - 1, record.buy)      ||
+		!parseInteger(fields[1], fields[2] - 1, record.price)    ||
+		!parseInteger(fields[2], fields[3] - 1, record.quantity) ||
+		!parseInteger(fields[4], fields[5] - 1, record.timestamp)) {
+		return false;
+	}
+	if (++_count == _batch.size()) {
+		flush();
+	}
+	return true;
+}
+
+void TradeLoader::malformed(const char* format, size_t offset)
+{
+	_stats.parseErrors++;
+	diagnostics().report(DIAG_TRADE_ROW_MALFORMED, NULL, format,
+						 (int64_t) _stats.rows, (int64_t) (_stats.bytes + offset));
+}
+
+void TradeLoader::loadCsv(const char* data, size_t size)
+{
+	const char* end   = data + size;
+	const char* line  = data;
+	bool        first = true;
+	while (line < end) {
+		const char* eol = static_cast<const char*>(memchr(line, '\n', end - line));
+		if (!eol) {
+			eol = end;
+		}
+		const char* last = eol;
+		if (last > line && *(last - 1) == '\r') {
+			--last;
+		}
+		if (last > line && *line != '#') {
+			if (!first || !isCsvHeader(line, last)) {
+				_stats.rows++;
+				if (!parseCsvLine(line, last)) {
+					malformed("CSV", line - data);
+				}
+			}
+			first = false;
+		}
+		line = eol + 1;
+	}
+	flush();
+	_stats.bytes += size;
+}
+
+bool TradeLoader::loadBinary(const char* data, size_t size)
+{
+	PackedTradesHeader header;
+	if (size < sizeof(header)) {
+		return false;
+	}
+	memcpy(&header, data, sizeof(header));
+	if (memcmp(header.magic, PACKED_TRADES_MAGIC, sizeof(PACKED_TRADES_MAGIC)) != 0 ||
+		header.version    != PACKED_TRADES_VERSION ||
+		header.recordSize != sizeof(PackedTrade)) {
+		return false;
+	}
+	size_t numRecords = (size - sizeof(header)) / sizeof(PackedTrade);
+	const PackedTrade* packed = reinterpret_cast<const PackedTrade*>(data + sizeof(header));
+	for (size_t i = 0; i < numRecords; ++i) {
+		PackedTrade const& trade  = packed[i];
+		TradeRecord&       record = _batch[_count];
+		_stats.rows++;
+		memcpy(record.symbol, trade.symbol, sizeof(trade.symbol));
+		record.symbol[MAX_SYMBOL_LENGTH] = '\0';
+		if (record.symbol[0] == '\0' || trade.buy > 1) {
+			malformed("binary", sizeof(header) + i * sizeof(PackedTrade));
+			continue;
+		}
+		record.id        = INVALID_SYMBOL;
+		record.price     = trade.price;
+		record.quantity  = trade.quantity;
+		record.buy       = trade.buy != 0;
+		record.timestamp = (time_t) trade.timestamp;
+		if (++_count == _batch.size()) {
+			flush();
+		}
+	}
+	// Trailing partial record
+	if ((size - sizeof(header)) % sizeof(PackedTrade) != 0) {
+		_stats.rows++;
+		malformed("binary", sizeof(header) + numRecords * sizeof(PackedTrade));
+	}
+	flush();
+	_stats.bytes += size;
+	return true;
+}
+
+bool TradeLoader::load(const char* path, TradeFileFormat format)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat status;
+	if (fstat(fd, &status) != 0) {
+		close(fd);
+		return false;
+	}
+	size_t size = (size_t) status.st_size;
+	if (size == 0) {
+		close(fd);
+		return format == TRADE_FILE_CSV;
+	}
+	void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		return false;
+	}
+	madvise(mapping, size, MADV_SEQUENTIAL);
+	
+	bool result = true;
+	if (format == TRADE_FILE_CSV) {
+		loadCsv(static_cast<const char*>(mapping), size);
+	} else {
+		result = loadBinary(static_cast<const char*>(mapping), size);
+	}
+	munmap(mapping, size);
+	return result;
+}
+
+bool TradeLoader::writeBinary(const char* path, TradeSpan trades)
+{
+	ofstream out(path, ios::binary | ios::trunc);
+	if (!out) {
+		return false;
+	}
+	PackedTradesHeader header;
+	memcpy(header.magic, PACKED_TRADES_MAGIC, sizeof(PACKED_TRADES_MAGIC));
+	header.version    = PACKED_TRADES_VERSION;
+	header.recordSize = sizeof(PackedTrade);
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	
+	for (auto const& record : trades) {
+		PackedTrade trade;
+		memset(&trade, 0, sizeof(trade));
+		trade.timestamp = record.timestamp;
+		trade.price     = record.price;
+		trade.quantity  = record.quantity;
+		trade.buy       = record.buy ? 1 : 0;
+		memcpy(trade.symbol, record.symbol, strnlen(record.symbol, sizeof(trade.symbol)));
+		out.write(reinterpret_cast<const char*>(&trade), sizeof(trade));
+	}
+	out.close();
+	return !out.fail();
+}
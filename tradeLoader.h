@@ -0,0 +1,96 @@
+#ifndef _TRADE_LOADER_H
+#define _TRADE_LOADER_H
+
+#include <stdint.h>
+#include <vector>
+#include "tradeRecord.h"
+
+// File declares the bulk loader of trade files.
+// Files are memory mapped and parsed in place: no memory is allocated per
+// row, trades are handed to the stock market in batches through
+// 'StockMarket::addTrades'.
+//
+// CSV format, one trade per line, lines starting with '#' are ignored and
+// the first line may be a header naming the fields, in any case:
+//     SYMBOL,PRICE,QUANTITY,SIDE,TIMESTAMP
+// SIDE is 'B' or 'BUY', 'S' or 'SELL' in any case, TIMESTAMP is in seconds
+// since epoch. Malformed rows are skipped, counted and reported through the
+// diagnostic channel.
+//
+// Binary format: a 'PackedTradesHeader' followed by 'PackedTrade' records.
+
+class StockMarket;
+
+//! Format of a trade file
+enum TradeFileFormat
+{
+	TRADE_FILE_CSV,
+	TRADE_FILE_BINARY
+};
+
+//! Header of a binary trade file
+struct PackedTradesHeader
+{
+	char     magic[8];
+	uint32_t version;
+	uint32_t recordSize;
+};
+
+//! Record of a binary trade file
+struct PackedTrade
+{
+	int64_t timestamp;
+	int32_t price;
+	int32_t quantity;
+	char    symbol[15];  // NUL padded, not terminated when 15 characters long
+	uint8_t buy;
+};
+
+//! Loading counters
+struct LoadStats
+{
+	size_t bytes;        // bytes parsed
+	size_t rows;         // rows read, including invalid ones
+	size_t parseErrors;  // rows that could not be parsed
+	size_t loaded;       // trades added to the stock market
+	size_t rejected;     // trades refused by the stock market (unregistered stock)
+};
+
+//! Streaming bulk loader feeding a stock market
+class TradeLoader
+{
+	public:
+		static const size_t DEFAULT_BATCH_SIZE = 4096;
+		
+		TradeLoader(StockMarket& market, size_t batchSize = DEFAULT_BATCH_SIZE);
+		
+		//! Accessing
+		LoadStats const& stats() const { return _stats; }
+		
+		//! Load all trades of a file into the stock market.
+		//! Counters are accumulated over successive loads.
+		//! Returns false if the file cannot be mapped or has an invalid binary header
+		bool load(const char* path, TradeFileFormat format);
+		
+		//! Parse trades from memory, as 'load' does with a mapped file
+		void loadCsv   (const char* data, size_t size);
+		bool loadBinary(const char* data, size_t size);
+		
+		//! Write trade records to a binary trade file
+		static bool writeBinary(const char* path, TradeSpan trades);
+		
+	private:
+		//! Parse one CSV line into the next record of the batch
+		bool parseCsvLine(const char* begin, const char* end);
+		
+		//! Count and report a row that could not be parsed
+		void malformed(const char* format, size_t offset);
+		void flush();
+		
+		StockMarket&             _market;
+		std::vector<TradeRecord> _batch;
+		size_t                   _count;  // records in the batch
+		LoadStats                _stats;
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef _TRADE_RECORD_H
+#define _TRADE_RECORD_H
+
+#include <cstring>
+#include "time.h"
+#include "symbolTable.h"
+
+// File declares the fixed size record used to move trades around in bulk
+// (ingestion queues, bulk APIs) without any memory allocation.
+
+//! Maximum length of a stock symbol held in a 'TradeRecord', the journal
+//! and the change notifications. Longer symbols are refused, never truncated:
+//! two symbols sharing their first characters would be taken for one stock
+const size_t MAX_SYMBOL_LENGTH = 15;
+
+//! Plain trade record. The stock is given by its symbol identifier when
+//! known by the producer, otherwise by its symbol
+struct TradeRecord
+{
+	char     symbol[MAX_SYMBOL_LENGTH + 1];  // NUL terminated
+	SymbolId id;                             // INVALID_SYMBOL if not known
+	int      price;
+	int      quantity;
+	bool     buy;
+	time_t   timestamp;
+};
+
+//! Fill a trade record. Returns false if the symbol is longer than
+//! MAX_SYMBOL_LENGTH, in which case the record symbol is left empty so
+//! the record cannot be taken for another stock
+inline bool setTradeRecord(TradeRecord& record,
+						   const char*  symbol,
+						   int          price,
+						   int          quantity,
+						   bool         buy,
+						   time_t       timestamp,
+						   SymbolId     id = INVALID_SYMBOL)
+{
+	size_t length = symbol ? strnlen(symbol, MAX_SYMBOL_LENGTH + 1) : 0;
+	bool   result = length <= MAX_SYMBOL_LENGTH;
+	if (!result) {
+		length = 0;
+	}
+	memcpy(record.symbol, symbol ? symbol : "", length);
+	record.symbol[length] = '\0';
+	record.id        = id;
+	record.price     = price;
+	record.quantity  = quantity;
+	record.buy       = buy;
+	record.timestamp = timestamp;
+	return result;
+}
+
+//! Non owning view over contiguous trade records
+class TradeSpan
+{
+	public:
+		TradeSpan() : _data(NULL), _size(0) {}
+		TradeSpan(const TradeRecord* data, size_t size) : _data(data), _size(size) {}
+		
+		//! Accessing
+		const TradeRecord* data () const { return _data;         }
+		size_t             size () const { return _size;         }
+		bool               empty() const { return _size == 0;    }
+		const TradeRecord* begin() const { return _data;         }
+		const TradeRecord* end  () const { return _data + _size; }
+		
+		TradeRecord const& operator[](size_t i) const { return _data[i]; }
+		
+	private:
+		const TradeRecord* _data;
+		size_t             _size;
+};
+
+#endif
@@ -0,0 +1,455 @@
+#include "tradeStore.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+using namespace std;
+
+TradeBlockPool::TradeBlockPool(Arena* arena, EpochManager* epochs) :
+				_arena     (arena),
+				_epochs    (epochs),
+				_bytesInUse(0),
+				_bytesFree (0)
+				{}
+
+size_t TradeBlockPool::blockBytes(size_t capacity)
+{
+	return capacity * (sizeof(time_t) + 2 * sizeof(int) + sizeof(unsigned char) + 2 * sizeof(int64_t));
+}
+
+size_t TradeBlockPool::capacityIndex(size_t capacity)
+{
+	size_t result = 0;
+	while (result + 1 < NUM_CAPACITIES && (TradeColumns::FIRST_BLOCK_SIZE << result) < capacity) {
+		result++;
+	}
+	return result;
+}
+
+TradeBlock* TradeBlockPool::acquire(size_t capacity)
+{
+	TradeBlock*  block = NULL;
+	TradeBlocks& free  = _free[capacityIndex(capacity)];
+	if (!free.empty()) {
+		block = free.back();
+		free.pop_back();
+		_bytesFree -= blockBytes(capacity);
+	} else {
+		block = _arena->create<TradeBlock>();
+		block->capacity   = capacity;
+		block->timestamps = _arena->allocateArray<time_t>       (capacity);
+		block->prices     = _arena->allocateArray<int>          (capacity);
+		block->quantities = _arena->allocateArray<int>          (capacity);
+		block->sides      = _arena->allocateArray<unsigned char>(capacity);
+		block->sumPriceQuantity = _arena->allocateArray<int64_t>(capacity);
+		block->sumQuantity      = _arena->allocateArray<int64_t>(capacity);
+	}
+	block->start = 0;
+	block->count = 0;
+	_bytesInUse += blockBytes(capacity);
+	return block;
+}
+
+void TradeBlockPool::release(TradeBlock* block)
+{
+	_free[capacityIndex(block->capacity)].push_back(block);
+	_bytesInUse -= blockBytes(block->capacity);
+	_bytesFree  += blockBytes(block->capacity);
+}
+
+void TradeBlockPool::retire(TradeBlock* block)
+{
+	if (_epochs) {
+		_epochs->retire([this, block]() { release(block); });
+	} else {
+		release(block);
+	}
+}
+
+TradeColumns::TradeColumns(string const& symbol, TradeBlockPool* pool) :
+				_symbol          (symbol),
+				_pool            (pool),
+				_blocks          (),
+				_size            (0),
+				_numExpired      (0),
+				_numExpiredBlocks(0),
+				_numPublished    (0),
+				_total           (),
+				_pending         ()
+				{}
+
+void TradeColumns::locate(size_t i, size_t& block, size_t& offset) const
+{
+	// Blocks sizes only depend on the position of the trades since the
+	// first one added: locate the trade among all blocks, expired included
+	i += _numExpired;
+	size_t start    = 0;
+	size_t capacity = FIRST_BLOCK_SIZE;
+	block = 0;
+	while (capacity < MAX_BLOCK_SIZE && i >= start + capacity) {
+		start    += capacity;
+		capacity *= 2;
+		block++;
+	}
+	if (i >= start + capacity) {
+		// All following blocks have the maximum size
+		size_t full = (i - start) / MAX_BLOCK_SIZE;
+		start += full * MAX_BLOCK_SIZE;
+		block += full;
+	}
+	block -= _numExpiredBlocks;
+	offset = i - start;
+}
+
+TradeBlock* TradeColumns::at(size_t i, size_t& offset) const
+{
+	size_t block;
+	locate(i, block, offset);
+	return _blocks[block];
+}
+
+int TradeColumns::price(size_t i) const
+{
+	size_t block, offset;
+	locate(i, block, offset);
+	return _blocks[block]->prices[offset];
+}
+
+int TradeColumns::quantity(size_t i) const
+{
+	size_t block, offset;
+	locate(i, block, offset);
+	return _blocks[block]->quantities[offset];
+}
+
+time_t TradeColumns::timestamp(size_t i) const
+{
+	size_t block, offset;
+	locate(i, block, offset);
+	return _blocks[block]->timestamps[offset];
+}
+
+bool TradeColumns::buying(size_t i) const
+{
+	size_t block, offset;
+	locate(i, block, offset);
+	return _blocks[block]->sides[offset] != 0;
+}
+
+TradeBlock* TradeColumns::newBlock(size_t capacity)
+{
+	TradeBlock* block = _pool->acquire(capacity);
+	block->start = _size;
+	return block;
+}
+
+TradeBlock* TradeColumns::writableBlock()
+{
+	if (_blocks.empty() || _blocks.back()->count == _blocks.back()->capacity) {
+		size_t capacity = _blocks.empty() ? FIRST_BLOCK_SIZE : _blocks.back()->capacity * 2;
+		if (capacity > MAX_BLOCK_SIZE) {
+			capacity = MAX_BLOCK_SIZE;
+		}
+		_blocks.push_back(newBlock(capacity));
+	}
+	return _blocks.back();
+}
+
+void TradeColumns::append(int price, int quantity, time_t timestamp, bool buy)
+{
+	TradeBlock* block = writableBlock();
+	size_t      i     = block->count++;
+	block->timestamps[i] = timestamp;
+	block->prices    [i] = price;
+	block->quantities[i] = quantity;
+	block->sides     [i] = buy ? 1 : 0;
+	_total.priceQuantity += (int64_t) price * quantity;
+	_total.quantity      += quantity;
+	block->sumPriceQuantity[i] = _total.priceQuantity;
+	block->sumQuantity     [i] = _total.quantity;
+	_size++;
+}
+
+void TradeColumns::insert(int price, int quantity, time_t timestamp, bool buy)
+{
+	TradeBlock const* last = _blocks.empty() ? NULL : _blocks.back();
+	if (!last || timestamp >= last->timestamps[last->count - 1]) {
+		append(price, quantity, timestamp, buy);
+	} else {
+		PendingTrade trade = { timestamp, price, quantity, buy };
+		_pending.push_back(trade);
+		if (_pending.size() >= REORDER_CAPACITY) {
+			flush();
+		}
+	}
+}
+
+void TradeColumns::flush()
+{
+	size_t numPending = _pending.size();
+	if (numPending == 0) {
+		return;
+	}
+	
+	stable_sort(_pending.begin(), _pending.end(), [](PendingTrade const& a, PendingTrade const& b) {
+		return a.timestamp < b.timestamp;
+	});
+	
+	// Published trades newer than the oldest waiting trade move:
+	// their blocks are replaced by copies before the merge
+	size_t first = TradesView(this).upperBound(_pending[0].timestamp);
+	for (size_t k = 0; k < _blocks.size() && first < _numPublished; ++k) {
+		TradeBlock* block = _blocks[k];
+		if (block->start + block->count > first && block->start < _numPublished) {
+			TradeBlock* copy = _pool->acquire(block->capacity);
+			copy->start = block->start;
+			copy->count = block->count;
+			memcpy(copy->timestamps, block->timestamps, block->count * sizeof(time_t));
+			memcpy(copy->prices,     block->prices,     block->count * sizeof(int));
+			memcpy(copy->quantities, block->quantities, block->count * sizeof(int));
+			memcpy(copy->sides,      block->sides,      block->count * sizeof(unsigned char));
+			memcpy(copy->sumPriceQuantity, block->sumPriceQuantity, block->count * sizeof(int64_t));
+			memcpy(copy->sumQuantity,      block->sumQuantity,      block->count * sizeof(int64_t));
+			_blocks[k] = copy;
+			_pool->retire(block);
+		}
+	}
+	if (first < _numPublished) {
+		_numPublished = first;
+	}
+	WindowSums before = sumsBefore(first);
+	
+	// Make room at the end, then merge from the end: the trades newer
+	// than a waiting trade move up, the older ones are not touched
+	size_t read = _size;
+	for (size_t i = 0; i < numPending; ++i) {
+		append(0, 0, 0, false);
+	}
+	size_t write = _size;
+	size_t j     = numPending;
+	while (j > 0) {
+		PendingTrade const& trade = _pending[j - 1];
+		size_t      to;
+		TradeBlock* dest = at(--write, to);
+		size_t      from;
+		TradeBlock* source = read > 0 ? at(read - 1, from) : NULL;
+		if (source && source->timestamps[from] > trade.timestamp) {
+			dest->timestamps[to] = source->timestamps[from];
+			dest->prices    [to] = source->prices    [from];
+			dest->quantities[to] = source->quantities[from];
+			dest->sides     [to] = source->sides     [from];
+			read--;
+		} else {
+			dest->timestamps[to] = trade.timestamp;
+			dest->prices    [to] = trade.price;
+			dest->quantities[to] = trade.quantity;
+			dest->sides     [to] = trade.buy ? 1 : 0;
+			j--;
+		}
+	}
+	_pending.clear();
+	sumFrom(first, before);
+}
+
+void TradeColumns::sumFrom(size_t i, WindowSums before)
+{
+	size_t k, offset;
+	locate(i, k, offset);
+	for (; k < _blocks.size(); ++k, offset = 0) {
+		TradeBlock* block = _blocks[k];
+		for (size_t j = offset; j < block->count; ++j) {
+			before.priceQuantity += (int64_t) block->prices[j] * block->quantities[j];
+			before.quantity      += block->quantities[j];
+			block->sumPriceQuantity[j] = before.priceQuantity;
+			block->sumQuantity     [j] = before.quantity;
+		}
+	}
+	_total = before;
+}
+
+WindowSums TradeColumns::sumsBefore(size_t i) const
+{
+	WindowSums result;
+	if (i > 0) {
+		size_t            offset;
+		TradeBlock const* block = at(i - 1, offset);
+		result.priceQuantity = block->sumPriceQuantity[offset];
+		result.quantity      = block->sumQuantity     [offset];
+	} else if (_size > 0) {
+		// Sums of the oldest trade kept, less its own values
+		TradeBlock const* block = _blocks[0];
+		result.priceQuantity = block->sumPriceQuantity[0] - (int64_t) block->prices[0] * block->quantities[0];
+		result.quantity      = block->sumQuantity     [0] - block->quantities[0];
+	}
+	return result;
+}
+
+WindowSums TradeColumns::sums(time_t from, time_t to) const
+{
+	WindowSums result = TradesView(this).sums(from, to);
+	for (auto const& trade : _pending) {
+		if (trade.timestamp >= from && trade.timestamp <= to) {
+			result.priceQuantity += (int64_t) trade.price * trade.quantity;
+			result.quantity      += trade.quantity;
+		}
+	}
+	return result;
+}
+
+void TradeColumns::append(const int*           prices,
+						  const int*           quantities,
+						  const time_t*        timestamps,
+						  const unsigned char* sides,
+						  size_t               count)
+{
+	while (count > 0) {
+		TradeBlock* block = writableBlock();
+		size_t      i     = block->count;
+		size_t      n     = std::min(count, block->capacity - i);
+		memcpy(block->timestamps + i, timestamps, n * sizeof(time_t));
+		memcpy(block->prices     + i, prices,     n * sizeof(int));
+		memcpy(block->quantities + i, quantities, n * sizeof(int));
+		memcpy(block->sides      + i, sides,      n * sizeof(unsigned char));
+		for (size_t j = i; j < i + n; ++j) {
+			_total.priceQuantity += (int64_t) block->prices[j] * block->quantities[j];
+			_total.quantity      += block->quantities[j];
+			block->sumPriceQuantity[j] = _total.priceQuantity;
+			block->sumQuantity     [j] = _total.quantity;
+		}
+		block->count += n;
+		_size        += n;
+		prices       += n;
+		quantities   += n;
+		timestamps   += n;
+		sides        += n;
+		count        -= n;
+	}
+}
+
+size_t TradeColumns::expire(size_t count)
+{
+	if (count >= _blocks.size()) {
+		count = _blocks.empty() ? 0 : _blocks.size() - 1;
+	}
+	size_t result = 0;
+	for (size_t k = 0; k < count; ++k) {
+		result += _blocks[k]->count;
+		if (_blocks[k]->start < _numPublished) {
+			_pool->retire(_blocks[k]);
+		} else {
+			_pool->release(_blocks[k]);
+		}
+	}
+	if (count > 0) {
+		_blocks.erase(_blocks.begin(), _blocks.begin() + count);
+		for (auto block : _blocks) {
+			block->start -= result;
+		}
+		_size             -= result;
+		_numPublished      = _numPublished > result ? _numPublished - result : 0;
+		_numExpired       += result;
+		_numExpiredBlocks += count;
+	}
+	return result;
+}
+
+TradeColumns TradeColumns::freeze(vector<TradeBlock>& headers)
+{
+	headers.clear();
+	headers.reserve(_blocks.size());
+	TradeColumns result(_symbol, _pool);
+	for (auto block : _blocks) {
+		headers.push_back(*block);
+	}
+	for (size_t k = 0; k < headers.size(); ++k) {
+		result._blocks.push_back(&headers[k]);
+	}
+	result._size             = _size;
+	result._numExpired       = _numExpired;
+	result._numExpiredBlocks = _numExpiredBlocks;
+	result._total            = _total;
+	_numPublished = _size;
+	return result;
+}
+
+TradesView::TradesView() :
+			_columns(NULL),
+			_size   (0)
+			{}
+
+TradesView::TradesView(const TradeColumns* columns) :
+			_columns(columns),
+			_size   (columns ? columns->size() : 0)
+			{}
+
+string const& TradesView::symbol() const
+{
+	static const string noSymbol;
+	return _columns ? _columns->symbol() : noSymbol;
+}
+
+size_t TradesView::blockSize(size_t k) const
+{
+	size_t start = _columns->block(k).start;
+	if (start >= _size) {
+		return 0;
+	}
+	size_t count = _columns->block(k).count;
+	return (_size - start < count) ? _size - start : count;
+}
+
+size_t TradesView::findBlock(time_t timestamp) const
+{
+	// Blocks are sorted: binary search on their last trade
+	size_t low  = 0;
+	size_t high = numBlocks();
+	while (low < high) {
+		size_t middle = (low + high) / 2;
+		size_t count  = blockSize(middle);
+		if (count == 0 || block(middle).timestamps[count - 1] >= timestamp) {
+			high = middle;
+		} else {
+			low = middle + 1;
+		}
+	}
+	return low;
+}
+
+size_t TradesView::lowerBound(time_t timestamp) const
+{
+	size_t k = findBlock(timestamp);
+	size_t count = k < numBlocks() ? blockSize(k) : 0;
+	if (count == 0) {
+		return _size;
+	}
+	TradeBlock const& b = block(k);
+	return b.start + (std::lower_bound(b.timestamps, b.timestamps + count, timestamp) - b.timestamps);
+}
+
+size_t TradesView::upperBound(time_t timestamp) const
+{
+	return timestamp == numeric_limits<time_t>::max() ? _size : lowerBound(timestamp + 1);
+}
+
+WindowSums TradesView::sums(time_t from, time_t to) const
+{
+	WindowSums result;
+	if (from <= to) {
+		size_t begin = lowerBound(from);
+		size_t end   = upperBound(to);
+		if (begin < end) {
+			WindowSums before = _columns->sumsBefore(begin);
+			result = _columns->sumsBefore(end);
+			result.priceQuantity -= before.priceQuantity;
+			result.quantity      -= before.quantity;
+		}
+	}
+	return result;
+}
+
+Trade TradesView::trade(size_t i) const
+{
+	Trade result(symbol().c_str(), price(i), quantity(i), buying(i));
+	result.timestamp(timestamp(i));
+	return result;
+}
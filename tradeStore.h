@@ -0,0 +1,273 @@
+#ifndef _TRADE_STORE_H
+#define _TRADE_STORE_H
+
+#include <vector>
+#include <string>
+#include "stockUtil.h"
+#include "arena.h"
+#include "windowKernels.h"
+#include "epochManager.h"
+
+// File declares the columnar storage of the trades of a given stock:
+// one contiguous array per trade field, the symbol is held once per stock.
+// A stored trade costs 17 bytes (price, quantity, timestamp and side)
+// instead of a heap allocated 'Trade' plus the pointer to it, and 16 more
+// for the running sums answering VWAP queries over any window.
+// Columns are split in blocks taken from the block pool of the stock market:
+// a block is never moved nor copied when more trades are added.
+// Trades are kept sorted by timestamp, so time range queries only
+// visit the blocks overlapping the range, and the sums of a window are
+// the difference of the running sums at its two ends.
+// Blocks are also the time partitions of the retention: the oldest blocks
+// expire whole and go back to a pool where new blocks are taken from, so
+// the memory of a market with a retention policy stays flat.
+
+class TradeColumns;
+class TradeJournal;
+
+typedef std::vector<TradeColumns*> TradeColumnsVec; // trades of each stock indexed by symbol identifier
+
+//! Columns of a block of consecutive trades.
+//! The running sums of a trade add its price*quantity and quantity to the
+//! sums of all trades before it, since the first trade of the stock
+struct TradeBlock
+{
+	size_t         start;             // index of the first trade of the block
+	size_t         capacity;
+	size_t         count;
+	time_t*        timestamps;
+	int*           prices;
+	int*           quantities;
+	unsigned char* sides;             // 1 for buy, 0 for sell
+	int64_t*       sumPriceQuantity;  // running sums
+	int64_t*       sumQuantity;
+};
+
+typedef std::vector<TradeBlock*> TradeBlocks;
+
+//! Retention of the trades of a stock market.
+//! Trades expire by whole blocks, the oldest first: a block expires when
+//! all its trades are older than 'maxAge' seconds before the most recent
+//! trade of the market, or when the newer trades of its stock are at least
+//! 'maxTradesPerStock', or when the blocks of the market exceed 'maxBytes'.
+//! The block being written never expires. Limits set to 0 are disabled.
+struct RetentionPolicy
+{
+	RetentionPolicy() : maxAge(0), maxTradesPerStock(0), maxBytes(0), archive(NULL) {}
+	
+	time_t        maxAge;             // seconds
+	size_t        maxTradesPerStock;
+	size_t        maxBytes;           // budget of the trade blocks of the market
+	TradeJournal* archive;            // journal receiving the expired trades, or NULL
+	
+	bool enabled() const { return maxAge > 0 || maxTradesPerStock > 0 || maxBytes > 0; }
+};
+
+//! Blocks of all stocks of a market. Expired blocks are kept in a free list
+//! per capacity and reused before allocating from the arena.
+//! Blocks read by published versions are retired through the epochs of
+//! the market, so they are reused once their readers are gone
+class TradeBlockPool
+{
+	public:
+		TradeBlockPool(Arena* arena, EpochManager* epochs = NULL);
+		
+		//! Block of the given capacity, a power of 2 between
+		//! FIRST_BLOCK_SIZE and MAX_BLOCK_SIZE of 'TradeColumns'
+		TradeBlock* acquire(size_t capacity);
+		
+		//! Give back a block no longer used
+		void release(TradeBlock* block);
+		
+		//! Give back a block no longer used by the writer, which may
+		//! still be read by the readers of a published version
+		void retire(TradeBlock* block);
+		
+		//! Accessing
+		size_t bytesInUse() const { return _bytesInUse; }
+		size_t bytesFree () const { return _bytesFree;  }
+		
+		//! Memory of the columns of a block of the given capacity
+		static size_t blockBytes(size_t capacity);
+		
+	private:
+		static const size_t NUM_CAPACITIES = 9;
+		
+		static size_t capacityIndex(size_t capacity);
+		
+		Arena*        _arena;
+		EpochManager* _epochs;
+		TradeBlocks   _free[NUM_CAPACITIES];  // indexed by capacity index
+		size_t        _bytesInUse;
+		size_t        _bytesFree;
+		
+	//! Disable copy constructor and 
+	//! copy assignment operator
+	TradeBlockPool(const TradeBlockPool&);
+	TradeBlockPool& operator=(const TradeBlockPool&);
+};
+
+//! Trades of a given stock stored as structure of arrays, sorted by timestamp.
+//! Blocks capacity doubles from FIRST_BLOCK_SIZE up to MAX_BLOCK_SIZE trades
+//! so rarely traded stocks do not waste memory.
+//! Trades arriving in time order are appended. Late trades wait in a reorder
+//! buffer, sorted and merged into the columns in one pass when it holds
+//! REORDER_CAPACITY trades or when the trades are read ('flush'). The buffer
+//! stays small as 'sums' scans it: a merge only moves the trades after the
+//! oldest waiting one, which are few when the trades are only a bit late.
+//! Trades of the same timestamp keep their arrival order.
+//! The oldest blocks can be dropped ('expire'): trade indexes then start
+//! at the oldest trade kept.
+//! Published trades ('freeze') are never written again: a merge copies
+//! the blocks it would rewrite, and dropped blocks are retired.
+//! NOTE: blocks memory belongs to the pool, copying a 'TradeColumns'
+//! does not copy the trades
+class TradeColumns
+{
+	public:
+		static const size_t FIRST_BLOCK_SIZE = 16;
+		static const size_t MAX_BLOCK_SIZE   = 4096;
+		static const size_t REORDER_CAPACITY = 64;
+		
+		TradeColumns(std::string const& symbol, TradeBlockPool* pool);
+		
+		//! Accessing
+		std::string const& symbol   () const { return _symbol;         }
+		size_t             size     () const { return _size;           }
+		bool               empty    () const { return _size == 0 && _pending.empty(); }
+		size_t             numPending() const { return _pending.size(); }
+		size_t             numBlocks() const { return _blocks.size();  }
+		TradeBlock const&  block    (size_t k) const { return *_blocks[k]; }
+		size_t             numExpired() const { return _numExpired;    }
+		
+		int    price    (size_t i) const;
+		int    quantity (size_t i) const;
+		time_t timestamp(size_t i) const;
+		bool   buying   (size_t i) const;
+		
+		//! Sums of the trades before the i-th one, since the first trade
+		//! added: the sums of consecutive trades are the difference of the
+		//! sums before and after them, expired trades do not matter
+		WindowSums sumsBefore(size_t i) const;
+		
+		//! Sums of the trades timestamped in [from, to], in O(log n),
+		//! the late trades of the reorder buffer included
+		WindowSums sums(time_t from, time_t to) const;
+		
+		//! Add a trade at its place in time: appended if it is not older than
+		//! the last trade, otherwise added to the reorder buffer
+		void insert(int price, int quantity, time_t timestamp, bool buy);
+		
+		//! Merge the reorder buffer into the columns, 'size' then
+		//! counts all trades
+		void flush();
+		
+		//! Append a trade at the end of the columns.
+		//! The trade must not be older than the last one
+		void append(int price, int quantity, time_t timestamp, bool buy);
+		
+		//! Append 'count' trades given as columns, copied block by block.
+		//! The trades must be sorted and not older than the last one
+		void append(const int*           prices,
+					const int*           quantities,
+					const time_t*        timestamps,
+					const unsigned char* sides,
+					size_t               count);
+		
+		//! Drop the 'count' oldest blocks, giving them back to the pool.
+		//! The last block is never dropped.
+		//! Returns the number of trades dropped
+		size_t expire(size_t count);
+		
+		//! Copy of the columns as they are now, for the readers of a published
+		//! version: the trades are shared, the block headers are copied into
+		//! 'headers' so the copy does not change when trades are added.
+		//! Trades of the copy are not written again by this columns
+		TradeColumns freeze(std::vector<TradeBlock>& headers);
+		
+	private:
+		//! Find the block and the offset in this block of the i-th trade
+		void locate(size_t i, size_t& block, size_t& offset) const;
+		
+		//! Block holding the i-th trade, and the trade offset in this block
+		TradeBlock* at(size_t i, size_t& offset) const;
+		
+		//! Last block, a new one is added if the last block is full
+		TradeBlock* writableBlock();
+		TradeBlock* newBlock(size_t capacity);
+		
+		//! Compute the running sums of the trades from the i-th one,
+		//! 'before' being the sums of the trades before it
+		void sumFrom(size_t i, WindowSums before);
+		
+		//! Late trade waiting to be merged
+		struct PendingTrade {
+			time_t timestamp;
+			int    price;
+			int    quantity;
+			bool   buy;
+		};
+		
+		std::string               _symbol;
+		TradeBlockPool*           _pool;
+		TradeBlocks               _blocks;
+		size_t                    _size;
+		size_t                    _numExpired;        // trades of the dropped blocks
+		size_t                    _numExpiredBlocks;
+		size_t                    _numPublished;      // trades read by a published version
+		WindowSums                _total;             // running sums of the last trade
+		std::vector<PendingTrade> _pending;   // reorder buffer in arrival order
+};
+
+//! Read only view over all trades of a given stock, sorted by timestamp.
+//! An invalid view is returned for a stock that has not been traded.
+//! The trades of the reorder buffer are not visible: flush the columns first.
+//! NOTE: the view size is fixed when the view is created, trades
+//! added later to the viewed stock are not visible, and late trades
+//! merged later move the trades of the view. A view must not be used
+//! once blocks of the viewed stock expired
+class TradesView
+{
+	public:
+		TradesView();
+		TradesView(const TradeColumns* columns);
+		
+		//! Accessing
+		bool               valid    () const { return _columns != NULL; }
+		size_t             size     () const { return _size;            }
+		bool               empty    () const { return _size == 0;       }
+		std::string const& symbol   () const;
+		
+		int    price    (size_t i) const { return _columns->price(i);     }
+		int    quantity (size_t i) const { return _columns->quantity(i);  }
+		time_t timestamp(size_t i) const { return _columns->timestamp(i); }
+		bool   buying   (size_t i) const { return _columns->buying(i);    }
+		
+		//! Contiguous blocks of trades, for scanning loops.
+		//! Use 'blockSize' instead of the block count to stay inside the view
+		size_t            numBlocks() const { return _columns ? _columns->numBlocks() : 0; }
+		TradeBlock const& block    (size_t k) const { return _columns->block(k); }
+		size_t            blockSize(size_t k) const;
+		
+		//! First block holding a trade timestamped at or after 'timestamp'
+		size_t            findBlock(time_t timestamp) const;
+		
+		//! Index of the first trade timestamped at or after 'timestamp',
+		//! and after 'timestamp', found by binary search
+		size_t lowerBound(time_t timestamp) const;
+		size_t upperBound(time_t timestamp) const;
+		
+		//! Sums of price*quantity and quantity of the trades of the view
+		//! timestamped in [from, to], from the running sums of the trades
+		//! found at both ends by binary search
+		WindowSums sums(time_t from, time_t to) const;
+		
+		//! Build a 'Trade' holding the values of the i-th trade
+		Trade trade(size_t i) const;
+		
+	private:
+		const TradeColumns* _columns;
+		size_t              _size;
+};
+
+#endif
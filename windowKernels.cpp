@@ -0,0 +1,115 @@
+#include "windowKernels.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define WINDOW_KERNELS_AVX2 1
+#include <immintrin.h>
+#endif
+
+typedef void (*WindowSumsKernel)(const time_t*, const int*, const int*, size_t,
+								 time_t, time_t, WindowSums&);
+
+void windowSumsScalar(const time_t* timestamps,
+					  const int*    prices,
+					  const int*    quantities,
+					  size_t        count,
+					  time_t        from,
+					  time_t        to,
+					  WindowSums&   sums)
+{
+	// Branchless: trades out of the window are multiplied by 0
+	int64_t sumPriceQuantity = 0;
+	int64_t sumQuantity      = 0;
+	for (size_t i = 0; i < count; ++i) {
+		int64_t inside = (timestamps[i] >= from) & (timestamps[i] <= to);
+		int64_t quantity = inside * quantities[i];
+		sumPriceQuantity += quantity * prices[i];
+		sumQuantity      += quantity;
+	}
+	sums.priceQuantity += sumPriceQuantity;
+	sums.quantity      += sumQuantity;
+}
+
+#ifdef WINDOW_KERNELS_AVX2
+
+//! 4 trades per step: 64 bits timestamps compared against the window,
+//! 32 bits prices and quantities widened to 64 bits and multiplied
+__attribute__((target("avx2")))
+static void windowSumsAvx2(const time_t* timestamps,
+						   const int*    prices,
+						   const int*    quantities,
+						   size_t        count,
+						   time_t        from,
+						   time_t        to,
+						   WindowSums&   sums)
+{
+	const __m256i lower = _mm256_set1_epi64x((long long) from);
+	const __m256i upper = _mm256_set1_epi64x((long long) to);
+	__m256i sumPriceQuantity = _mm256_setzero_si256();
+	__m256i sumQuantity      = _mm256_setzero_si256();
+	
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m256i time     = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(timestamps + i));
+		__m256i outside  = _mm256_or_si256(_mm256_cmpgt_epi64(lower, time),
+										   _mm256_cmpgt_epi64(time, upper));
+		__m256i price    = _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(prices + i)));
+		__m256i quantity = _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(quantities + i)));
+		quantity         = _mm256_andnot_si256(outside, quantity);
+		sumPriceQuantity = _mm256_add_epi64(sumPriceQuantity, _mm256_mul_epi32(price, quantity));
+		sumQuantity      = _mm256_add_epi64(sumQuantity, quantity);
+	}
+	
+	int64_t lanes[4];
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), sumPriceQuantity);
+	sums.priceQuantity += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), sumQuantity);
+	sums.quantity      += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	
+	windowSumsScalar(timestamps + i, prices + i, quantities + i, count - i, from, to, sums);
+}
+
+#endif
+
+//! Kernel used by 'windowSums' and its name
+struct KernelChoice {
+	WindowSumsKernel kernel;
+	const char*      name;
+};
+
+static KernelChoice selectKernel()
+{
+	KernelChoice result = { &windowSumsScalar, "scalar" };
+#ifdef WINDOW_KERNELS_AVX2
+	// May run before the constructors of the runtime: initialize the CPU model
+	__builtin_cpu_init();
+	if (sizeof(time_t) == sizeof(long long) && __builtin_cpu_supports("avx2")) {
+		result.kernel = &windowSumsAvx2;
+		result.name   = "avx2";
+	}
+#endif
+	return result;
+}
+
+//! Chosen on first use, so stock markets built by the static initializers
+//! of other translation units find it ready
+static KernelChoice const& kernelChoice()
+{
+	static const KernelChoice choice = selectKernel();
+	return choice;
+}
+
+void windowSums(const time_t* timestamps,
+				const int*    prices,
+				const int*    quantities,
+				size_t        count,
+				time_t        from,
+				time_t        to,
+				WindowSums&   sums)
+{
+	kernelChoice().kernel(timestamps, prices, quantities, count, from, to, sums);
+}
+
+const char* windowKernelName()
+{
+	return kernelChoice().name;
+}
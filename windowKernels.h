@@ -0,0 +1,44 @@
+#ifndef _WINDOW_KERNELS_H
+#define _WINDOW_KERNELS_H
+
+#include <stdint.h>
+#include <cstddef>
+#include "time.h"
+
+// File declares the aggregation kernels computing the sums needed for a
+// 'Volume Weighted Stock Price' over contiguous trade columns.
+// An AVX2 kernel is used when the CPU supports it, chosen at runtime,
+// otherwise a portable scalar kernel. All sums are 64 bits so
+// price * quantity cannot overflow.
+
+//! Sums of price*quantity and quantity of a set of trades
+struct WindowSums
+{
+	WindowSums() : priceQuantity(0), quantity(0) {}
+	
+	int64_t priceQuantity;
+	int64_t quantity;
+};
+
+//! Add to 'sums' the trades of the columns timestamped in [from, to]
+void windowSums(const time_t* timestamps,
+				const int*    prices,
+				const int*    quantities,
+				size_t        count,
+				time_t        from,
+				time_t        to,
+				WindowSums&   sums);
+
+//! Same as above, always using the scalar kernel
+void windowSumsScalar(const time_t* timestamps,
+					  const int*    prices,
+					  const int*    quantities,
+					  size_t        count,
+					  time_t        from,
+					  time_t        to,
+					  WindowSums&   sums);
+
+//! Name of the kernel used by 'windowSums' ("avx2" or "scalar")
+const char* windowKernelName();
+
+#endif